@@ -1,5 +1,6 @@
 /* The docstring of serial_annealer-impl.hpp also applies here. */
 template class Annealer<AbsoluteZero>;
+template class Annealer<AdaptiveDisorder>;
 template class Annealer<ExpDecayDisorder>;
 template class Annealer<LinearDecayDisorder>;
 template class Annealer<NoDisorder>;
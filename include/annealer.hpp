@@ -1,11 +1,20 @@
 #ifndef ANNEALER_HPP
 #define ANNEALER_HPP
 
+#include "annealer_policies.hpp"
 #include "disorder_schedules.hpp"
 #include "problem.hpp"
+#include "snapshotter.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <fstream>
+#include <limits>
+#include <memory>
+#include <span>
 #include <string>
+#include <vector>
 
 template <class DisorderT=ExpDecayDisorder>
 class Annealer
@@ -17,12 +26,251 @@ public:
              Seed disorderSeed=kSeedSkip);
     void operator()(Problem& problem){anneal(problem);}
 
+    /* Begin the disorder schedule part of the way through, for annealing
+     * from a good initial condition. */
+    void warm_start(double fraction);
+
+    /* Stop before the maximum number of iterations once the anneal has
+     * converged. Each criterion is disabled until set. */
+    void stop_on_stagnation(Iteration window);
+    void stop_on_low_acceptance(double threshold, Iteration window);
+    void stop_on_target(float target);
+
+    /* Run for a wall-clock budget instead of a number of iterations. */
+    void run_for(double seconds, Iteration sampleEvery=1000);
+
+    /* Scale the disorder schedule to the problem before annealing. */
+    void calibrate(double startAcceptanceArg, double endAcceptanceArg,
+                   unsigned samples=2000);
+
+    /* Keep the best state seen, and reheat if it stops improving. */
+    void retain_best(Iteration checkpointEveryArg);
+    void reheat_on_stagnation(Iteration window, double fraction,
+                              bool restartFromBestArg=true);
+
+    /* Snapshot the placement in the background while annealing. */
+    void snapshot_every(double seconds);
+
+    /* Save the state of the anneal periodically, and resume from a saved
+     * state. */
+    void save_resume_every(Iteration every);
+    void resume_from(const std::filesystem::path& path);
+
+    /* Number of iterations the last anneal ran for (over every subproblem,
+     * if staged). */
+    Iteration iterationsRun = 0;
+
 protected:
     Iteration maxIteration;
     DisorderT disorder;
     std::string handle = "Annealer (undefined)";
     virtual void anneal(Problem& problem) = 0;
 
+    /* Where to begin the disorder schedule, as set by warm_start. */
+    double warmStartFraction = 0;
+    Iteration firstIteration = 0;
+
+    /* Stopping criteria, as set by stop_on_*. */
+    Iteration stagnationWindow = 0;
+    double acceptanceThreshold = 0;
+    Iteration acceptanceWindow = 0;
+    bool useTargetFitness = false;
+    float targetFitness = 0;
+
+    /* Time budget, as set by run_for (zero seconds means there is no
+     * budget), and when the budget started to be spent. */
+    double timeBudget = 0;
+    Iteration clockSampleEvery = 1000;
+    std::chrono::steady_clock::time_point budgetStart;
+
+    /* Calibration, as set by calibrate (zero samples means no calibration),
+     * and its outcome. */
+    unsigned calibrationSamples = 0;
+    double startAcceptance = 0;
+    double endAcceptance = 0;
+    double startTemperature = 0;
+    double endTemperature = 0;
+    void calibrate_disorder(Problem& problem);
+
+    /* Best-state retention and reheating, as set by retain_best and
+     * reheat_on_stagnation (zero disables), and their state during an
+     * anneal. Once reheated, what is left of the anneal (from schedule
+     * position `reheatFrom`) is stretched over the schedule from `reheatTo`
+     * to maxIteration, so that every reheat still ends cold. */
+    Iteration checkpointEvery = 0;
+    Iteration reheatWindow = 0;
+    double reheatFraction = 0;
+    bool restartFromBest = true;
+    std::vector<unsigned> bestLocations;
+    float bestFitness = 0;
+    Iteration lastImprovement = 0;
+    Iteration reheatFrom = 0;
+    Iteration reheatTo = 0;
+    double reheatScale = 1;
+    unsigned reheats = 0;
+    void begin_retention(Problem& problem, Iteration iteration);
+    bool checkpoint(Problem& problem, float fitness, Iteration iteration,
+                    Iteration schedulePosition);
+    void end_retention(Problem& problem);
+    Iteration reheated(Iteration schedulePosition)
+    {
+        return schedulePosition > reheatFrom ?
+            reheatTo + static_cast<Iteration>(
+                static_cast<double>(schedulePosition - reheatFrom) *
+                reheatScale) : reheatTo;
+    }
+
+    /* Background snapshots of the placement, as set by snapshot_every (zero
+     * seconds disables). Each snapshot is stamped with `progress`, which
+     * annealers keep at (about) the current iteration while snapshotting. */
+    double snapshotPeriod = 0;
+    std::unique_ptr<Snapshotter> snapshotter;
+    void begin_snapshots(Problem& problem,
+                         const std::atomic<Iteration>& progress);
+    void end_snapshots();
+    constexpr static auto snapshotDirName = "snapshots";
+
+    /* Convergence tracking for a single worker, padded so that workers don't
+     * share cache lines. Workers in a parallel anneal each hold one, and vote
+     * to stop once converged. */
+    enum class StopReason {none, stagnation, lowAcceptance, target,
+                           budgetSpent};
+    struct alignas(64) Convergence
+    {
+        float bestFitness = -std::numeric_limits<float>::infinity();
+        Iteration sinceImprovement = 0;
+        Iteration windowLength = 0;
+        Iteration windowAcceptances = 0;
+        bool voted = false;
+    };
+    static const char* describe(StopReason reason);
+
+    /* Updates a worker's convergence tracking with the outcome of an
+     * iteration (the fitness after determination, and whether the
+     * transformation was accepted), and returns whether, and why, it has
+     * converged. Defined here because it is called every iteration. */
+    StopReason check_convergence(Convergence& state, float fitness,
+                                 bool accepted)
+    {
+        if (useTargetFitness and fitness >= targetFitness)
+            return StopReason::target;
+
+        if (stagnationWindow != 0)
+        {
+            if (fitness > state.bestFitness)
+            {
+                state.bestFitness = fitness;
+                state.sinceImprovement = 0;
+            }
+            else if (++state.sinceImprovement >= stagnationWindow)
+                return StopReason::stagnation;
+        }
+
+        if (acceptanceWindow != 0)
+        {
+            state.windowAcceptances += accepted;
+            if (++state.windowLength == acceptanceWindow)
+            {
+                auto rate = static_cast<double>(state.windowAcceptances) /
+                    static_cast<double>(state.windowLength);
+                state.windowLength = 0;
+                state.windowAcceptances = 0;
+                if (rate < acceptanceThreshold)
+                    return StopReason::lowAcceptance;
+            }
+        }
+
+        return StopReason::none;
+    }
+
+    /* Builds the problem's fixed-degree view with the narrowest row width
+     * that annealers are compiled for (see FixedDegree), if any fits the
+     * application graph. Returns that width, or zero if none fits. Callers
+     * clear the view once they are done. Building the view costs a pass over
+     * the whole application graph, which a local re-anneal (with selection
+     * restricted, see problem_incremental.cpp) would not earn back, so there
+     * is no view then. */
+    unsigned begin_fixed_degree(Problem& problem)
+    {
+        if (problem.selection_restricted()) return 0;
+        auto maxDegree = problem.compute_max_a_degree();
+        unsigned degree = 0;
+        if (maxDegree <= 2) degree = 2;
+        else if (maxDegree <= 4) degree = 4;
+        if (degree != 0) problem.build_fixed_degree_view(degree);
+        return degree;
+    }
+
+    /* In time-budget mode, moves a worker's position in the disorder schedule
+     * (`scheduleIteration`) to the elapsed fraction of the budget, given that
+     * the worker has run `elapsed` iterations since it last called. The clock
+     * is only read once every clockSampleEvery iterations, as counted down by
+     * `countdown` (so zero reads it now). Returns false once the budget is
+     * spent. */
+    bool advance_schedule(Iteration& countdown, Iteration& scheduleIteration,
+                          Iteration elapsed)
+    {
+        if (countdown > elapsed)
+        {
+            countdown -= elapsed;
+            return true;
+        }
+        countdown = clockSampleEvery;
+        auto fraction = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - budgetStart).count() /
+            timeBudget;
+        if (fraction >= 1) return false;
+        scheduleIteration = firstIteration + static_cast<Iteration>(
+            fraction * static_cast<double>(maxIteration - firstIteration));
+        return true;
+    }
+
+    /* Resume files, as set by save_resume_every (zero disables) and
+     * resume_from (empty unless the next anneal is to resume). Callers save
+     * between iterations, while no workers are transforming, and load once
+     * their state has been set up (including retention), which it
+     * overwrites. load_resume returns false if there was nothing to resume
+     * from. */
+    Iteration resumeEvery = 0;
+    std::filesystem::path resumePath;
+    bool resuming(){return !resumePath.empty();}
+    void save_resume(Problem& problem, Iteration iteration,
+                     ExactFitness clusteringFitness,
+                     ExactFitness localityFitness,
+                     std::span<const Convergence> convergences);
+    bool load_resume(Problem& problem, Iteration& iteration,
+                     ExactFitness& clusteringFitness,
+                     ExactFitness& localityFitness,
+                     std::span<Convergence> convergences);
+    constexpr static auto resumeName = "resume.bin";
+    constexpr static char resumeMagic[8] = {'P', 'S', 'A', 'P',
+                                            'R', 'S', 'M', 'E'};
+    constexpr static std::uint32_t resumeVersion = 2;
+
+    /* Iterations left on a countdown that restarts every `every` iterations,
+     * `elapsed` iterations since it first started (e.g. for a resumed
+     * anneal). */
+    static Iteration countdown_after(Iteration every, Iteration elapsed)
+        {return every == 0 ? 0 : every - elapsed % every;}
+
+    /* Whether any stopping criterion is checked every iteration (see
+     * CheckConvergence). */
+    bool checks_convergence()
+        {return useTargetFitness or stagnationWindow != 0 or
+            acceptanceWindow != 0;}
+
+    /* Length of the chunks of iterations that hot loops run between handling
+     * everything else (see annealer_policies.hpp). */
+    constexpr static Iteration chunkLength = 1024;
+
+    /* The iteration at which to stop, unless stopped early (there is none in
+     * time-budget mode). */
+    Iteration end_iteration()
+    {
+        if (timeBudget > 0) return std::numeric_limits<Iteration>::max();
+        return maxIteration;
+    }
+
     /* Output stuff - logging has to go somewhere. */
     std::filesystem::path outDir;
     bool log = false;
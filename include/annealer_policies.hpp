@@ -0,0 +1,43 @@
+#ifndef ANNEALER_POLICIES_HPP
+#define ANNEALER_POLICIES_HPP
+
+/* Policies that the annealers compile their hot loops with, so that a feature
+ * that is switched off costs nothing per iteration - branches on a policy are
+ * resolved at compile time with `if constexpr`. The annealers choose a
+ * combination once per anneal (see SerialAnnealer::anneal and
+ * ParallelAnnealer::choose_co_anneal). Features that need no work per
+ * iteration (checkpoints, resume files, time budgets, progress for snapshots,
+ * and folding fitness between workers) are handled between fixed-length
+ * chunks of iterations instead, whatever the policies.
+ *
+ * Logging: whether each iteration is written to the operations CSV. Snapshots
+ * are only taken while logging, so this also decides whether transformations
+ * keep a published placement in step (see Problem::publish_locations). */
+struct LogToCsv{static constexpr bool enabled = true;};
+struct NoLogging{static constexpr bool enabled = false;};
+
+/* Convergence: whether each iteration is checked against the stopping
+ * criteria (see Annealer::check_convergence). Implied by logging. */
+struct CheckConvergence{static constexpr bool enabled = true;};
+struct NoConvergence{static constexpr bool enabled = false;};
+
+/* Synchronisation (parallel only): whether selection locks the neighbourhood
+ * of a transformation (synchronous), or just the selected application node
+ * (semi-asynchronous). See problem_selectors.cpp. */
+struct Synchronous{static constexpr bool synchronous = true;};
+struct SemiAsynchronous{static constexpr bool synchronous = false;};
+
+/* Footprint tracking (parallel only): whether transform counters are
+ * maintained, so that unreliable fitness computations can be counted (see
+ * ParallelAnnealer::compute_transform_footprint). Implied by logging. */
+struct TrackFootprints{static constexpr bool enabled = true;};
+struct NoFootprints{static constexpr bool enabled = false;};
+
+/* Degree: whether locality fitness is computed from the problem's
+ * fixed-degree view, with rows of `maxDegree` entries (see
+ * problem_fixed_degree.cpp), or by walking neighbours (any degree). */
+template <unsigned MaxDegree>
+struct FixedDegree{static constexpr unsigned maxDegree = MaxDegree;};
+struct AnyDegree{static constexpr unsigned maxDegree = 0;};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef BINARY_IO_HPP
+#define BINARY_IO_HPP
+
+#include "seed.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/* Helpers for the binary files PSAP writes (placement snapshots and resume
+ * files), in native byte order. Vectors and strings are written as their
+ * length (uint64) followed by their contents. Readers return false once the
+ * stream fails (e.g. if the file is truncated), and fail the stream rather
+ * than allocate for a length longer than what is left of it. */
+
+/* Bytes left to read in `in` (zero if it can't tell), for checking lengths
+ * read from a file before allocating for them. */
+inline std::uint64_t remaining_bytes(std::istream& in)
+{
+    auto here = in.tellg();
+    if (here == std::istream::pos_type(-1)) return 0;
+    in.seekg(0, std::istream::end);
+    auto end = in.tellg();
+    in.seekg(here);
+    if (end == std::istream::pos_type(-1) or end < here) return 0;
+    return static_cast<std::uint64_t>(end - here);
+}
+
+template <class T>
+void write_binary(std::ostream& out, const T& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <class T>
+bool read_binary(std::istream& in, T& value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return static_cast<bool>(in);
+}
+
+template <class T>
+void write_binary(std::ostream& out, const std::vector<T>& values)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    write_binary(out, static_cast<std::uint64_t>(values.size()));
+    out.write(reinterpret_cast<const char*>(values.data()),
+              static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+template <class T>
+bool read_binary(std::istream& in, std::vector<T>& values)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    std::uint64_t size;
+    if (!read_binary(in, size)) return false;
+    if (size > remaining_bytes(in) / sizeof(T))
+    {
+        in.setstate(std::istream::failbit);
+        return false;
+    }
+    values.resize(size);
+    in.read(reinterpret_cast<char*>(values.data()),
+            static_cast<std::streamsize>(size * sizeof(T)));
+    return static_cast<bool>(in);
+}
+
+inline void write_binary(std::ostream& out, const std::string& value)
+{
+    write_binary(out, static_cast<std::uint64_t>(value.size()));
+    out.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+inline bool read_binary(std::istream& in, std::string& value)
+{
+    std::uint64_t size;
+    if (!read_binary(in, size)) return false;
+    if (size > remaining_bytes(in))
+    {
+        in.setstate(std::istream::failbit);
+        return false;
+    }
+    value.resize(size);
+    in.read(value.data(), static_cast<std::streamsize>(size));
+    return static_cast<bool>(in);
+}
+
+/* Generators only serialise as text, which is then written as a string. */
+inline void write_binary(std::ostream& out, const Prng& rng)
+{
+    std::ostringstream state;
+    state << rng;
+    write_binary(out, state.str());
+}
+
+inline bool read_binary(std::istream& in, Prng& rng)
+{
+    std::string text;
+    if (!read_binary(in, text)) return false;
+    std::istringstream state(text);
+    state >> rng;
+    return !state.fail();
+}
+
+/* Writes a file by calling `write(stream)`, under a temporary name that is
+ * then renamed to `path`, so that a reader (or a run killed part-way through
+ * writing) never sees a partial file. Returns false if writing failed, in
+ * which case `path` is untouched. */
+template <class Writer>
+bool write_atomically(const std::filesystem::path& path, Writer write)
+{
+    auto temporaryPath = path;
+    temporaryPath += ".tmp";
+    std::ofstream out(temporaryPath, std::ofstream::binary |
+                      std::ofstream::trunc);
+    write(out);
+    out.close();
+    if (!out) return false;
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    return !error;
+}
+
+#endif
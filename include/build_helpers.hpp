@@ -0,0 +1,55 @@
+#ifndef BUILD_HELPERS_HPP
+#define BUILD_HELPERS_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/* Helpers for building problems at runtime, shared by problem files (see
+ * problem_files.cpp) and problem generators (see problem_generators.cpp). */
+
+/* Splits a line into fields. */
+inline void split_fields(std::string_view line,
+                         std::vector<std::string_view>& fields)
+{
+    fields.clear();
+    std::string_view::size_type start = 0;
+    while (true)
+    {
+        start = line.find_first_not_of(" \t\r", start);
+        if (start == std::string_view::npos) return;
+        auto end = line.find_first_of(" \t\r", start);
+        if (end == std::string_view::npos) end = line.size();
+        fields.push_back(line.substr(start, end - start));
+        start = end;
+    }
+}
+
+/* Parses a whole field as a number. */
+template <class T>
+bool parse_field(std::string_view field, T& value)
+{
+    auto result = std::from_chars(field.data(), field.data() + field.size(),
+                                  value);
+    return result.ec == std::errc() and
+        result.ptr == field.data() + field.size();
+}
+
+/* Calls `construct(first, last)` over contiguous slices of [0, size), one per
+ * thread. */
+template <class Construct>
+void construct_in_parallel(std::size_t size, unsigned numThreads,
+                           Construct construct)
+{
+    numThreads = std::max(numThreads, 1u);
+    std::vector<std::thread> threads;
+    for (unsigned thread = 0; thread < numThreads; thread++)
+        threads.emplace_back(construct, size * thread / numThreads,
+                             size * (thread + 1) / numThreads);
+    for (auto& thread : threads) thread.join();
+}
+
+#endif
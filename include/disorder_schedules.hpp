@@ -3,24 +3,65 @@
 
 #include "seed.hpp"
 
+#include <array>
+#include <atomic>
+#include <istream>
+#include <ostream>
 #include <string>
 
 /* Overflow is a real possibility, believe me. Better to incur a small memory
  * penalty than to check for overflow every iteration. */
 typedef unsigned long long Iteration;
 
+/* Schedules with a `calibrate(startTemperature, endTemperature)` method can
+ * be calibrated to the problem by the annealer (see
+ * Annealer::calibrate). Temperatures are in units of fitness, such that an
+ * inferior solution is accepted with probability exp(-difference /
+ * temperature).
+ *
+ * Schedules decide on inferior solutions with accept_inferior, which avoids
+ * transcendental functions on the hot path (see disorder_schedules.cpp). */
 class Disorder
 {
 public:
     Disorder(Iteration maxIteration, Seed seed=kSeedSkip);
     virtual bool determine(float, float, Iteration) = 0;
 
+    /* Resumable state (see Annealer::resume_from), including the per-worker
+     * state of the calling thread. */
+    virtual void save_state(std::ostream& out);
+    virtual bool load_state(std::istream& in);
+
 protected:
     Iteration maxIteration;
 
     /* Randomness source and distribution for disorder. */
     Prng rng;
     std::uniform_real_distribution<> distribution{0, 1};
+
+    /* Fast acceptance. Per-worker state (thresholds and cached temperatures)
+     * is keyed by instance, because workers are threads and outlive
+     * schedules. */
+    bool accept_inferior(double fitnessDifference, double temperature);
+    double cached_temperature(Iteration iteration);
+    double cached_shift(Iteration iteration);
+    virtual double compute_temperature(Iteration){return 1;}
+    virtual double compute_shift(Iteration){return 0;}
+    template <double (Disorder::*Compute)(Iteration)>
+    double cached(Iteration iteration);
+    const unsigned long long instance = nextInstance++;
+    static inline std::atomic<unsigned long long> nextInstance = 1;
+
+    /* Differences more than this many temperatures away are rejected without
+     * drawing (exp(-25) is about 1e-11). */
+    constexpr static double acceptanceCutoff = 25;
+    constexpr static unsigned thresholdBatchSize = 256;
+
+    /* Temperatures are held for this many iterations at a time: a thousandth
+     * of the anneal, so that short anneals still cool, but no more than
+     * maxTemperatureRefresh. */
+    Iteration temperatureRefresh;
+    constexpr static Iteration maxTemperatureRefresh = 1024;
 };
 
 /* There is no disorder and no acceptance - the state never changes. */
@@ -38,10 +79,17 @@ class ExpDecayDisorder: public Disorder
 public:
     ExpDecayDisorder(Iteration maxIteration, Seed seed=kSeedSkip);
     bool determine(float, float, Iteration);
+    void calibrate(double startTemperature, double endTemperature);
+    void save_state(std::ostream& out);
+    bool load_state(std::istream& in);
     const char* handle = "ExpDecayDisorder";
 
+protected:
+    double compute_temperature(Iteration iteration);
+
 private:
     double disorderDecay;
+    double disorderOffset = 0;
 };
 
 /* Disorder decays linearly. Better solutions are always accepted. */
@@ -50,11 +98,51 @@ class LinearDecayDisorder: public Disorder
 public:
     LinearDecayDisorder(Iteration maxIteration, Seed seed=kSeedSkip);
     bool determine(float, float, Iteration);
+    void calibrate(double startTemperature, double endTemperature);
+    void save_state(std::ostream& out);
+    bool load_state(std::istream& in);
     const char* handle = "LinearDecayDisorder";
 
+protected:
+    double compute_temperature(Iteration iteration);
+    double compute_shift(Iteration iteration);
+
 private:
     double gradient;
     double intercept;
+    bool calibrated = false;
+};
+
+/* Disorder adapts to steer the rate at which transformations are accepted
+ * towards a target rate that varies over the anneal (the "modified Lam"
+ * schedule) - high early on, constant in the middle, and decaying towards
+ * zero at the end. Each worker measures its acceptance rate over windows of
+ * its own iterations (with no sharing), and nudges a shared temperature up or
+ * down at the end of each window. The temperature starts at the magnitude of
+ * the first inferior solution seen. Better solutions are always accepted. */
+class AdaptiveDisorder: public Disorder
+{
+public:
+    AdaptiveDisorder(Iteration maxIteration, Seed seed=kSeedSkip);
+    bool determine(float, float, Iteration);
+    void calibrate(double startTemperature, double endTemperature);
+    double target_acceptance(Iteration iteration);
+    void save_state(std::ostream& out);
+    bool load_state(std::istream& in);
+    const char* handle = "AdaptiveDisorder";
+
+private:
+    std::atomic<double> temperature = 0;
+    void record(bool accepted, Iteration iteration);
+    constexpr static unsigned windowSize = 100;
+    constexpr static double temperatureStep = 0.97;
+
+    /* Shape of the target curve, as fractions of the anneal. Swartz's
+     * original plateau (0.44, from 0.15 to 0.65) spends too long hot for the
+     * iteration budgets we use; these values were tuned on the examples. */
+    constexpr static double plateauAcceptance = 0.3;
+    constexpr static double plateauStart = 0.05;
+    constexpr static double plateauEnd = 0.2;
 };
 
 /* There is no disorder. Better solutions are always accepted. */
@@ -1,20 +1,110 @@
 /* A quick and dirty config file for a bunch of properties used by main to
- * organise annealing. */
+ * organise annealing. Some can be overridden on the command line (run with
+ * --help for a list), so that sweeps need not recompile. */
 
 /* Mouse mode - useful for runtime measurements. */
 bool mouseMode = false;
 
+/* Output - written to a directory named after the problem, in this one. */
+std::string outputRoot = "output";
+
+/* Problem - if a path to a problem file (text or binary; see
+ * problem_files.cpp) is given, the problem is loaded from it at runtime (using
+ * numWorkers threads), instead of using the problem definition compiled in. */
+std::string problemPath = "";
+
+/* Problem generator - if no problem path is given, but a generator spec is
+ * (see problem_generators.cpp, e.g. "a=grid diameter=1414 boards=3x4"), the
+ * problem is generated at runtime (using numWorkers threads). */
+std::string generatorSpec = "";
+
 /* Whether or not to anneal in serial, or parallel. */
 bool serial = false;
 
 /* If parallel, number of workers to use. */
 unsigned numWorkers = 1;
 
+/* Whether or not to anneal in stages following the hardware hierarchy (using
+ * numWorkers workers). Takes precedence over serial. */
+bool staged = false;
+
 /* Synchronisity (serial=false only) - do we synchronise to ensure no
  * computation with stale data (true), or do we only synchronise only to
  * ensure data structure integrity (false)? */
 bool fullySynchronous = false;
 
+/* Initial condition - one of "bucket", "curve" (space-filling curve),
+ * "partition" (recursive bisection, using numWorkers threads), or
+ * "random". */
+std::string initialCondition = "random";
+
+/* Disorder schedule - one of "exp" (exponential decay), "linear" (linear
+ * decay), "adaptive", "none" (better solutions only), or "zero" (nothing is
+ * accepted). */
+std::string schedule = "exp";
+
+/* Warm starting - if a path to a previous a_to_h map is given, it is used as
+ * the initial condition (instead of initialCondition), and annealing begins
+ * this fraction of the way through the disorder schedule. */
+std::string warmStartPath = "";
+double warmStartFraction = 0;
+
+/* Early stopping - stop once the best fitness has not improved for
+ * stagnationWindow iterations, once fewer than acceptanceThreshold (a
+ * fraction) of transformations are accepted over acceptanceWindow iterations,
+ * or once targetFitness is reached (if useTargetFitness). Zero windows
+ * disable. */
+Iteration stagnationWindow = 0;
+double acceptanceThreshold = 0;
+Iteration acceptanceWindow = 0;
+bool useTargetFitness = false;
+float targetFitness = 0;
+
+/* Time budget - if nonzero, anneal for this many seconds of wall-clock time
+ * (serial or parallel only), with disorder driven by the elapsed fraction of
+ * the budget instead of by maxIteration. */
+double timeBudget = 0;
+
+/* Disorder calibration - if true, scale disorder to the problem before
+ * annealing, such that inferior solutions are accepted with these mean
+ * probabilities at the start and end of the anneal. */
+bool calibrateDisorder = false;
+double startAcceptance = 0.2;
+double endAcceptance = 0.00001;
+
+/* Best-state retention - if nonzero, checkpoint the best state every this many
+ * iterations, and end on it. If reheatWindow is also nonzero, reheat to
+ * reheatFraction of the way through the disorder schedule once the best has
+ * not improved for that many iterations, restarting from the best state if
+ * restartFromBest. */
+Iteration checkpointEvery = 0;
+Iteration reheatWindow = 0;
+double reheatFraction = 0.5;
+bool restartFromBest = true;
+
+/* Placement snapshots - if nonzero, write a binary snapshot of the placement
+ * to the "snapshots" output directory every this many seconds of annealing
+ * (serial or parallel only), without stopping the workers. */
+double snapshotEvery = 0;
+
+/* Resuming - if resumeEvery is nonzero, save the state of the anneal to
+ * "resume.bin" in the output directory every this many iterations (serial or
+ * parallel only). If a path to such a file is given, resume the anneal from
+ * it (instead of from the initial condition). */
+Iteration resumeEvery = 0;
+std::string resumePath = "";
+
+/* Sweep - if a sweep spec is given, the problem (and its edge cache) is
+ * prepared once, then placed with the initial condition and annealed once for
+ * each combination of the lists in the spec, with results written to
+ * "sweep.csv" in the output directory (or to stdout in mouse mode). The spec
+ * is a list of "<KEY>=<VALUE>[,<VALUE>...]" fields, with keys "modes"
+ * (serial, parallel, staged), "workers", "sync" (0 or 1), "seeds",
+ * "schedules", and "repeats" (a single count), e.g. "modes=serial,parallel
+ * workers=1,4,8 seeds=1,2 repeats=10". Keys not given take the values
+ * configured here. */
+std::string sweepSpec = "";
+
 /* Seed, if any. */
 bool useSeed = false;
 Seed seed = 1;
@@ -45,16 +45,26 @@ public:
     std::atomic<TransformCount> transformCount = 0;
 };
 
-/* Node in the application graph. */
+/* Node in the application graph. Positions are optional, and are used by
+ * geometry-aware initial conditions if defined for every application node. */
 class NodeA: public Node
 {
 public:
     NodeA(std::string name): Node(name){}
+    NodeA(std::string name, float posHoriz, float posVerti):
+        Node(name), posHoriz(posHoriz), posVerti(posVerti){}
     std::weak_ptr<NodeH> location;
     std::vector<std::weak_ptr<NodeA>> neighbours;
+    float posHoriz = -1;
+    float posVerti = -1;
 };
 
-/* Node in the hardware graph. */
+/* Node in the hardware graph. The address is optional, and locates the node
+ * in a hardware hierarchy (outermost level first, e.g. board, mailbox, core)
+ * for staged annealing. If defined, it must be defined for every hardware
+ * node, and must have the same length for each of them. Unavailable nodes
+ * (see Problem::disable_h_node) are never selected, and hold no application
+ * nodes. */
 class NodeH: public Node
 {
 public:
@@ -65,6 +75,8 @@ public:
     unsigned index;
     float posHoriz = -1;
     float posVerti = -1;
+    std::vector<unsigned> address;
+    bool available = true;
 };
 
 #endif
@@ -1,5 +1,6 @@
 /* The docstring of serial_annealer-impl.hpp also applies here. */
 template class ParallelAnnealer<AbsoluteZero>;
+template class ParallelAnnealer<AdaptiveDisorder>;
 template class ParallelAnnealer<ExpDecayDisorder>;
 template class ParallelAnnealer<LinearDecayDisorder>;
 template class ParallelAnnealer<NoDisorder>;
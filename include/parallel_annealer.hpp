@@ -18,13 +18,27 @@ public:
     void operator()(Problem& problem, bool fullySynchronous=false)
         {anneal(problem, fullySynchronous);}
 
-    /* Parallel compute unit */
-    void co_anneal_synchronous(
-        Problem& problem, std::ofstream& csvOut, Iteration maxIteration,
-        float oldClusteringFitness, float oldLocalityFitness);
-    void co_anneal_sasynchronous(
+    /* A worker's contribution to the shared fitness (accepted changes not yet
+     * folded in), and how far its view of the fitness had deviated from the
+     * shared fitness each time it folded. Aligned to avoid false sharing. */
+    struct alignas(64) WorkerView
+    {
+        ExactFitness pendingClustering = 0;
+        ExactFitness pendingLocality = 0;
+        double deviationTotal = 0;
+        double deviationMax = 0;
+        Iteration folds = 0;
+    };
+
+    /* Parallel compute unit, for a set of policies (see
+     * annealer_policies.hpp). */
+    template <class LogT, class SyncT, class FootprintT, class ConvergenceT,
+              class DegreeT>
+    void co_anneal(
         Problem& problem, std::ofstream& csvOut, Iteration maxIteration,
-        float oldClusteringFitness, float oldLocalityFitness);
+        ExactFitness oldClusteringFitness, ExactFitness oldLocalityFitness,
+        typename Annealer<DisorderT>::Convergence& convergence,
+        WorkerView& view);
 
     /* Transformation utilities */
     static TransformCount compute_transform_footprint(
@@ -36,14 +50,53 @@ public:
                                   decltype(Problem::nodeAs)::iterator& selA,
                                   decltype(Problem::nodeHs)::iterator& selH,
                                   decltype(Problem::nodeHs)::iterator& oldH);
+    template <class SyncT, class FootprintT, bool FixedView=false,
+              bool MayPublish=true>
+    static void policy_transform(Problem& problem,
+                                 decltype(Problem::nodeAs)::iterator& selA,
+                                 decltype(Problem::nodeHs)::iterator& selH,
+                                 decltype(Problem::nodeHs)::iterator& oldH);
 
     /* Tracking the number of iterations with reliable fitness computation
-     * (matching transformation footprints). */
+     * (matching transformation footprints). Only counted when logging, or
+     * when asked to with track_footprints. */
+    void track_footprints(bool track=true);
     std::atomic<unsigned long long> reliableIterations = 0;
 
 private:
     unsigned numThreads;
     std::atomic<Iteration> iteration = 0;
+    bool trackFootprints = false;
+
+    /* Choosing the compute unit for the policies in effect. */
+    typedef void (ParallelAnnealer::*CoAnneal)(
+        Problem&, std::ofstream&, Iteration, ExactFitness, ExactFitness,
+        typename Annealer<DisorderT>::Convergence&, WorkerView&);
+    template <class SyncT> CoAnneal choose_co_anneal(unsigned degree);
+    template <class SyncT, class FootprintT, class ConvergenceT>
+    CoAnneal choose_degree(unsigned degree);
+
+    /* Fitness shared between workers, in exact units. Each worker folds its
+     * accepted changes in after every chunk of fitnessFoldEvery iterations
+     * (see co_anneal), and takes the result as its view of the fitness. It
+     * is reset to the true fitness whenever that is computed. Synchronous workers compute changes exactly,
+     * so the shared fitness is exact; semi-asynchronous workers may compute
+     * changes from stale data, which the shared fitness then drifts with. */
+    std::atomic<ExactFitness> sharedClusteringFitness = 0;
+    std::atomic<ExactFitness> sharedLocalityFitness = 0;
+    constexpr static Iteration fitnessFoldEvery = 64;
+    void fold_fitness(WorkerView& view, ExactFitness& clusteringFitness,
+                      ExactFitness& localityFitness);
+    void log_worker_views(Problem& problem,
+                          const std::vector<WorkerView>& views);
+
+    /* Early stopping. Workers vote to stop once converged, and all stop when
+     * every worker has voted (or immediately, if the target is reached). */
+    std::atomic<bool> stopping = false;
+    std::atomic<unsigned> convergedWorkers = 0;
+    std::atomic<typename Annealer<DisorderT>::StopReason> stopReason;
+    void vote_to_stop(typename Annealer<DisorderT>::Convergence& convergence,
+                      typename Annealer<DisorderT>::StopReason reason);
 
     /* Anneal methods. Note that I don't use optional arguments here because
      * Annealer has a pure virtual anneal(Problem) method, and I want to
@@ -4,16 +4,25 @@
 #include "nodes.hpp"
 #include "seed.hpp"
 
+#include <atomic>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <limits>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <string>
 #include <sstream>
 #include <tuple>
+#include <utility>
 #include <vector>
 
+/* Fitness in fixed point, in units of 1 / Problem::fitnessScale. Deltas of
+ * exact fitness are exact, so running totals don't drift (see
+ * compute_app_node_locality_fitness_exact). */
+typedef long long ExactFitness;
+
 class Problem
 {
 public:
@@ -28,6 +37,19 @@ public:
 
     /* Set up PRNG */
     void set_seed(Seed seed=kSeedSkip);
+    void save_rng(std::ostream& out);
+    bool load_rng(std::istream& in);
+
+    /* Problem files (see problem_files.cpp). */
+    bool load_problem(const std::string_view& path, std::stringstream& errors,
+                      unsigned numThreads=1);
+    void write_problem(const std::string_view& path);
+    void write_problem_binary(const std::string_view& path,
+                              bool withEdgeCache=true);
+
+    /* Problem generators (see problem_generators.cpp). */
+    bool generate_problem(const std::string_view& specText,
+                          std::stringstream& errors, unsigned numThreads=1);
 
     /* Logging and pathing */
     void define_output_path(const std::filesystem::path& outDirArg);
@@ -37,10 +59,44 @@ public:
     /* Methods that interact with edgeCacheH. */
     void initialise_edge_cache(unsigned diameter);
     void populate_edge_cache();
+    bool has_edge_cache(){return !edgeCacheH.empty();}
+
+    /* Hierarchy (see problem_hierarchy.cpp) */
+    unsigned compute_h_hierarchy_depth();
+    void define_coarse_problem(
+        Problem& coarse, const std::vector<unsigned>& aIndices,
+        const std::vector<std::vector<unsigned>>& hGroups);
 
     /* Initial conditions for the annealer. */
     void initial_condition_bucket();
+    void initial_condition_curve();
+    void initial_condition_partition(unsigned numThreads=1);
     void initial_condition_random();
+    bool initial_condition_warm(const std::string_view& path,
+                                std::stringstream& errors);
+    void clear_locations();
+
+    /* Greedy placement of single application nodes. To place many, build a
+     * load order once and pass it each time. */
+    typedef std::set<std::pair<std::size_t, unsigned>> LoadOrder;
+    void build_load_order(LoadOrder& loadOrder);
+    void place_greedily(decltype(nodeAs)::size_type aIndex);
+    void place_greedily(decltype(nodeAs)::size_type aIndex,
+                        LoadOrder& loadOrder);
+
+    /* Incremental changes to the application graph (see
+     * problem_incremental.cpp). */
+    float add_app_node(const std::shared_ptr<NodeA>& nodeA);
+    float add_app_edge(decltype(nodeAs)::size_type first,
+                       decltype(nodeAs)::size_type second);
+    float remove_app_edge(decltype(nodeAs)::size_type first,
+                          decltype(nodeAs)::size_type second);
+    float remove_app_node(decltype(nodeAs)::size_type aIndex);
+    std::vector<unsigned> compute_neighbourhood(
+        const std::vector<unsigned>& aIndices, unsigned hops);
+    void restrict_selection(const std::vector<unsigned>& aIndices);
+    bool selection_restricted(){return !selectableAs.empty();}
+    bool disable_h_node(unsigned hIndex, std::vector<unsigned>& evacuated);
 
     /* Neighbouring state selection. */
     unsigned select_serial(decltype(nodeAs)::iterator& selA,
@@ -53,17 +109,50 @@ public:
                                          decltype(nodeHs)::iterator& selH,
                                          decltype(nodeHs)::iterator& oldH);
 
-    /* Transformation from selection data. */
+    /* Transformation from selection data. Annealers' hot loops know whether
+     * there is a fixed-degree view and a published placement to keep in
+     * step, and use transform_with, which doesn't check. */
     void transform(decltype(nodeAs)::iterator& selA,
                    decltype(nodeHs)::iterator& selH,
                    decltype(nodeHs)::iterator& oldH);
+    template <bool FixedView, bool MayPublish>
+    void transform_with(decltype(nodeAs)::iterator& selA,
+                        decltype(nodeHs)::iterator& selH,
+                        decltype(nodeHs)::iterator& oldH);
+
+    /* Cheap snapshots of the placement. */
+    void snapshot_locations(std::vector<unsigned>& aToH);
+    void restore_locations(const std::vector<unsigned>& aToH);
+    bool valid_locations(const std::vector<unsigned>& aToH);
+
+    /* Placement published for reading while annealing (see
+     * Snapshotter). */
+    void publish_locations();
+    void withdraw_locations();
+    void read_published_locations(std::vector<unsigned>& aToH);
+
+    /* Fixed-degree view of the application graph (see
+     * problem_fixed_degree.cpp). */
+    unsigned compute_max_a_degree();
+    void build_fixed_degree_view(unsigned degree);
+    void clear_fixed_degree_view();
 
     /* Fitness calculators */
     float compute_app_node_locality_fitness(const NodeA& nodeA);
     float compute_hw_node_clustering_fitness(const NodeH& nodeH);
-    float compute_total_fitness();
+    float compute_total_fitness(unsigned numThreads=1);
     float compute_total_clustering_fitness();
-    float compute_total_locality_fitness();
+    float compute_total_locality_fitness(unsigned numThreads=1);
+
+    /* Exact fitness calculators, for annealing. */
+    template <unsigned MaxDegree>
+    ExactFitness compute_app_node_locality_fitness_exact(
+        const decltype(nodeAs)::iterator& selA);
+    ExactFitness compute_hw_node_clustering_fitness_exact(const NodeH& nodeH);
+    ExactFitness compute_total_clustering_fitness_exact();
+    ExactFitness compute_total_locality_fitness_exact(unsigned numThreads=1);
+    static double to_fitness(ExactFitness exact)
+        {return static_cast<double>(exact) / fitnessScale;}
 
     /* Integrity checking */
     bool check_lock_integrity(std::stringstream& errors);
@@ -83,10 +172,25 @@ public:
      * which a message is logged. */
     constexpr static float selectionPatience = 1e3;
 
+    /* Resolution of exact fitness. Edge weights are quantised to multiples
+     * of its reciprocal. */
+    constexpr static ExactFitness fitnessScale = 1 << 16;
+
 private:
     std::vector<std::vector<float>> edgeCacheH;
     Prng rng;
 
+    unsigned place_near_neighbours(decltype(nodeAs)::size_type aIndex,
+                                   unsigned fallbackHIndex);
+
+    /* The edge cache in exact units, quantised from edgeCacheH whenever that
+     * changes, with distances capped to keep sums from overflowing. */
+    std::vector<std::vector<ExactFitness>> edgeCacheExact;
+    ExactFitness exactDistanceCap = std::numeric_limits<ExactFitness>::max();
+    void quantise_edge_cache();
+    void quantise_edge_cache(const std::vector<unsigned>& hIndices);
+    ExactFitness quantise_distance(float distance);
+
     /* Logging and pathing */
     std::filesystem::path outDir;
     std::ofstream logS;
@@ -94,7 +198,60 @@ private:
 
     constexpr static auto logHandle = "log.txt";
 
+    /* Binary problem files (see problem_files.cpp). */
+    bool load_problem_binary(std::ifstream& in, const std::string_view& path,
+                             std::stringstream& errors, unsigned numThreads);
+    constexpr static char binaryMagic[8] = {'P', 'S', 'A', 'P',
+                                            'P', 'R', 'O', 'B'};
+    constexpr static std::uint32_t binaryVersion = 1;
+
+    /* Fixed-degree view (see problem_fixed_degree.cpp). Empty unless
+     * built. */
+    unsigned fixedDegree = 0;
+    std::vector<unsigned> fixedNeighbours;
+    std::vector<unsigned> fixedLocations;
+
+    /* Published placement (hardware node index for each application node),
+     * which transformation keeps in step with relaxed stores. Empty unless
+     * published. */
+    std::vector<std::atomic<unsigned>> publishedLocations;
+
+    /* Total locality fitness over a slice of application nodes. */
+    template <class Sum, class Distance>
+    Sum sum_locality_fitness(
+        const std::vector<std::vector<Distance>>& edgeCache,
+        std::size_t first, std::size_t last);
+
+    /* Incremental distance update (see problem_incremental.cpp) */
+    void update_edge_cache_without(unsigned hIndex);
+
+    /* Index-based view of the application graph */
+    void build_a_adjacency(std::vector<unsigned>& offsets,
+                           std::vector<unsigned>& targets);
+
+    /* Hardware nodes in service, for initial conditions. */
+    void list_available_h_nodes(std::vector<unsigned>& hIndices);
+
+    /* Space-filling curve ordering (see problem_curve.cpp) */
+    void order_a_along_curve(std::vector<unsigned>& order);
+    void order_h_along_curve(std::vector<unsigned>& order);
+
+    /* Recursive bisection (see problem_partition.cpp) */
+    void partition_bisect(unsigned long long subsetId,
+                          std::vector<unsigned>& aSubset,
+                          std::vector<unsigned>& hSubset,
+                          const std::vector<unsigned>& aOffsets,
+                          const std::vector<unsigned>& aTargets,
+                          std::vector<std::atomic<unsigned long long>>& aLabels,
+                          std::vector<unsigned long long>& aStamps,
+                          unsigned numThreads);
+
+    /* Application nodes (by index) that selection is restricted to - all of
+     * them if empty. */
+    std::vector<unsigned> selectableAs;
+
     /* Granular selection */
+    decltype(nodeAs)::size_type roll_sela();
     void select_serial_sela(decltype(nodeAs)::iterator& selA);
     void select_serial_oldh(decltype(nodeAs)::iterator& selA,
                             decltype(nodeHs)::iterator& oldH);
@@ -108,4 +265,57 @@ private:
                                             decltype(nodeHs)::iterator& avoid);
 };
 
+/* As compute_app_node_locality_fitness, but in exact units. Uses the
+ * fixed-degree view, which must have been built with rows of MaxDegree
+ * entries, unless MaxDegree is zero (in which case the neighbours of the node
+ * are walked as usual). With the view, the loop has a fixed length, and
+ * padding entries read a valid (but irrelevant) distance that is then
+ * discarded, so that there is no branching on the degree. */
+template <unsigned MaxDegree>
+ExactFitness Problem::compute_app_node_locality_fitness_exact(
+    const decltype(nodeAs)::iterator& selA)
+{
+    ExactFitness returnValue = 0;
+    if constexpr (MaxDegree == 0)
+    {
+        const auto& edgeCacheRow =
+            edgeCacheExact[(*selA)->location.lock()->index];
+        for (const auto& neighbourPtr : (*selA)->neighbours)
+            returnValue -= edgeCacheRow[
+                neighbourPtr.lock()->location.lock()->index];
+    }
+    else
+    {
+        auto aIndex = static_cast<unsigned>(selA - nodeAs.begin());
+        auto padding = static_cast<unsigned>(nodeAs.size());
+        const auto* neighbours = fixedNeighbours.data() + aIndex * MaxDegree;
+        const auto* edgeCacheRow =
+            edgeCacheExact[fixedLocations[aIndex]].data();
+        for (unsigned slot = 0; slot < MaxDegree; slot++)
+        {
+            auto distance = edgeCacheRow[fixedLocations[neighbours[slot]]];
+            returnValue -= neighbours[slot] == padding ? 0 : distance;
+        }
+    }
+    return returnValue;
+}
+
+/* As transform, for a problem whose fixed-degree view is built if and only if
+ * `FixedView`, and whose placement may only be published if `MayPublish`. */
+template <bool FixedView, bool MayPublish>
+void Problem::transform_with(decltype(nodeAs)::iterator& selA,
+                             decltype(nodeHs)::iterator& selH,
+                             decltype(nodeHs)::iterator& oldH)
+{
+    (*oldH)->contents.erase(selA->get());
+    (*selA)->location = std::weak_ptr(*selH);
+    (*selH)->contents.insert(selA->get());
+    if constexpr (FixedView)
+        fixedLocations[selA - nodeAs.begin()] = (*selH)->index;
+    if constexpr (MayPublish)
+        if (!publishedLocations.empty())
+            publishedLocations[selA - nodeAs.begin()].store(
+                (*selH)->index, std::memory_order_relaxed);
+}
+
 #endif
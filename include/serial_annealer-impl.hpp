@@ -8,6 +8,7 @@
  * If you prefer the TPP approach and want to use it instead of this method,
  * that's fine too. If you're in a Git repository, look at 0dfc24f. */
 template class SerialAnnealer<AbsoluteZero>;
+template class SerialAnnealer<AdaptiveDisorder>;
 template class SerialAnnealer<ExpDecayDisorder>;
 template class SerialAnnealer<LinearDecayDisorder>;
 template class SerialAnnealer<NoDisorder>;
@@ -16,7 +16,15 @@ public:
 
 private:
     Iteration iteration = 0;
+
+    /* The iteration, published for snapshots (see
+     * Annealer::begin_snapshots). */
+    std::atomic<Iteration> progress = 0;
+
     void anneal(Problem& problem);
+    template <class ConvergenceT> void anneal_with_degree(Problem& problem);
+    template <class LogT, class ConvergenceT, class DegreeT>
+    void anneal_with(Problem& problem);
 
     /* Output file names. If no output directory is provided, no output is
      * written. */
@@ -0,0 +1,73 @@
+#ifndef SNAPSHOTTER_HPP
+#define SNAPSHOTTER_HPP
+
+#include "disorder_schedules.hpp"
+#include "problem.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Writes snapshots of the placement of a problem from a background thread
+ * while it is being annealed, without stopping the workers. The problem
+ * publishes its placement for the lifetime of the snapshotter (see
+ * Problem::publish_locations), and each snapshot is a relaxed copy of it,
+ * stamped with an epoch (the number of snapshots before it) and with the
+ * iteration the anneal had reached when the copy began.
+ *
+ * Snapshots are written to `dir` as "snapshot-<epoch>.bin", each holding
+ * (native byte order):
+ *
+ * - The magic bytes "PSAPSNAP", and the format version (uint32) followed by
+ *   four reserved bytes.
+ *
+ * - The epoch, the iteration, and the number of application nodes
+ *   (uint64 each).
+ *
+ * - The index of the hardware node holding each application node (uint32
+ *   each, by application node index).
+ *
+ * Files are written under a temporary name and renamed into place, so a
+ * reader never sees a partial snapshot. */
+class Snapshotter
+{
+public:
+    Snapshotter(Problem& problemArg, const std::filesystem::path& dirArg,
+                double periodSeconds,
+                const std::atomic<Iteration>& progressArg);
+    ~Snapshotter();
+
+    /* Reads a snapshot written by a snapshotter. Returns false if the file
+     * is not a snapshot (or is truncated). */
+    static bool read(const std::filesystem::path& path,
+                     std::vector<unsigned>& aToH, std::uint64_t& epoch,
+                     Iteration& iteration);
+
+    constexpr static char magic[8] = {'P', 'S', 'A', 'P',
+                                      'S', 'N', 'A', 'P'};
+    constexpr static std::uint32_t version = 1;
+
+private:
+    Problem& problem;
+    std::filesystem::path dir;
+    std::chrono::duration<double> period;
+    const std::atomic<Iteration>& progress;
+    std::uint64_t epoch = 0;
+    std::vector<unsigned> aToH;
+
+    /* The background thread sleeps between snapshots until woken to
+     * stop. */
+    std::mutex stopLock;
+    std::condition_variable stopSignal;
+    bool stopping = false;
+    std::thread thread;
+    void run();
+    void take();
+};
+
+#endif
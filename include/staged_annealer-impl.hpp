@@ -0,0 +1,6 @@
+/* The docstring of serial_annealer-impl.hpp also applies here. */
+template class StagedAnnealer<AbsoluteZero>;
+template class StagedAnnealer<AdaptiveDisorder>;
+template class StagedAnnealer<ExpDecayDisorder>;
+template class StagedAnnealer<LinearDecayDisorder>;
+template class StagedAnnealer<NoDisorder>;
@@ -0,0 +1,47 @@
+#ifndef STAGED_ANNEALER_HPP
+#define STAGED_ANNEALER_HPP
+
+#include "annealer.hpp"
+
+#include <filesystem>
+#include <vector>
+
+/* Anneals in stages that follow the hierarchy of the hardware graph (see
+ * nodes.hpp). Application nodes are first annealed onto the outermost groups
+ * of hardware nodes (e.g. boards), then onto the groups within each of those
+ * groups (e.g. mailboxes), and so on, until they are annealed onto hardware
+ * nodes. Each stage is a coarse problem (see problem_hierarchy.cpp) annealed
+ * with the serial annealer. The coarse problems at each level are independent,
+ * and are annealed in parallel. */
+template <class DisorderT=ExpDecayDisorder>
+class StagedAnnealer: public Annealer<DisorderT>
+{
+public:
+    StagedAnnealer(unsigned numThreads=1, Iteration maxIterationArg=100,
+                   const std::filesystem::path& outDirArg="",
+                   Seed disorderSeed=kSeedSkip);
+    void operator()(Problem& problem){anneal(problem);}
+
+private:
+    unsigned numThreads;
+    Seed disorderSeed;
+    void anneal(Problem& problem);
+
+    /* Application nodes to be placed on a set of hardware nodes (by index in
+     * the problem). */
+    struct Subproblem
+    {
+        std::vector<unsigned> aIndices;
+        std::vector<unsigned> hIndices;
+    };
+
+    /* Output file names. If no output directory is provided, no output is
+     * written. */
+    constexpr static auto csvPath = "anneal_stages.csv";
+    constexpr static auto clockPath = "wallclock.txt";
+
+    /* Metadata writing */
+    void write_metadata();
+};
+
+#endif
@@ -35,33 +35,42 @@ enum class Dir {outerP, outerN, innerP, innerN};
 const std::array<Dir, 4> directions = {Dir::outerP, Dir::outerN,
                                        Dir::innerP, Dir::innerN};
 
-/* Create a nested array that identifies the index (in nodeAs) of an
- * application node given its (context-sensitive) position in the grid. */
-std::array<std::array<decltype(problem.nodeAs)::size_type, gridDiameter>,
-           gridDiameter> aIndexGivenPos;
+/* Application nodes are created row by row, so the index (in nodeAs) of an
+ * application node is a function of its (context-sensitive) position in the
+ * grid. */
+auto aIndexGivenPos = [](decltype(problem.nodeAs)::size_type outer,
+                         decltype(problem.nodeAs)::size_type inner)
+{
+    return outer * gridDiameter + inner;
+};
 
-/* Create application nodes */
+/* Create application nodes, with zero-padded names. */
 decltype(problem.nodeAs)::size_type aInnerIndex, aOuterIndex;
 auto locWidth = std::to_string(gridDiameter).size();
+auto padded = [&locWidth](decltype(aOuterIndex) value)
+{
+    auto digits = std::to_string(value);
+    return std::string(locWidth - digits.size(), '0') + digits;
+};
 for (aOuterIndex = 0; aOuterIndex < gridDiameter; aOuterIndex++)
 {
+    auto namePrefix = "A_" + padded(aOuterIndex) + "_";
     for (aInnerIndex = 0; aInnerIndex < gridDiameter; aInnerIndex++)
     {
-        std::stringstream name;
-        name << "A_" << std::setw(locWidth) << std::setfill('0') << aOuterIndex
-             << "_" << std::setw(locWidth) << std::setfill('0') << aInnerIndex;
-        problem.nodeAs.push_back(std::make_shared<NodeA>(name.str()));
-        aIndexGivenPos[aOuterIndex][aInnerIndex] = problem.nodeAs.size() - 1;
+        problem.nodeAs.push_back(std::make_shared<NodeA>(
+            namePrefix + padded(aInnerIndex),
+            static_cast<float>(aOuterIndex),
+            static_cast<float>(aInnerIndex)));
     }
 }
 
-/* Define application node neighbours by iterating over the nested array. */
+/* Define application node neighbours by iterating over the grid. */
 for (aOuterIndex = 0; aOuterIndex < gridDiameter; aOuterIndex++)
 {
     for (aInnerIndex = 0; aInnerIndex < gridDiameter; aInnerIndex++)
     {
         /* Lookup index for this node, and get a weak pointer. */
-        auto aIndex = aIndexGivenPos.at(aOuterIndex).at(aInnerIndex);
+        auto aIndex = aIndexGivenPos(aOuterIndex, aInnerIndex);
         auto aPtr = std::weak_ptr(problem.nodeAs.at(aIndex));
 
         /* Iterate over each direction in the topology. */
@@ -79,20 +88,20 @@ for (aOuterIndex = 0; aOuterIndex < gridDiameter; aOuterIndex++)
             decltype(aInnerIndex) nIndex;
             switch (direction)
             {
-                case Dir::outerP: nIndex = aIndexGivenPos.at(aOuterIndex + 1)\
-                                     .at(aInnerIndex);
+                case Dir::outerP: nIndex = aIndexGivenPos(aOuterIndex + 1,
+                                                          aInnerIndex);
                                   break;
 
-                case Dir::outerN: nIndex = aIndexGivenPos.at(aOuterIndex - 1)\
-                                     .at(aInnerIndex);
+                case Dir::outerN: nIndex = aIndexGivenPos(aOuterIndex - 1,
+                                                          aInnerIndex);
                                   break;
 
-                case Dir::innerP: nIndex = aIndexGivenPos.at(aOuterIndex)\
-                                     .at(aInnerIndex + 1);
+                case Dir::innerP: nIndex = aIndexGivenPos(aOuterIndex,
+                                                          aInnerIndex + 1);
                                   break;
 
-                case Dir::innerN: nIndex = aIndexGivenPos.at(aOuterIndex)\
-                                     .at(aInnerIndex - 1);
+                case Dir::innerN: nIndex = aIndexGivenPos(aOuterIndex,
+                                                          aInnerIndex - 1);
                                   break;
 
                 default: nIndex = std::numeric_limits<decltype(nIndex)>::max();
@@ -148,6 +157,10 @@ for (decltype(problem.nodeHs)::size_type coreIdx = 0;
          << "_" << coreIdx;
     problem.nodeHs.push_back(std::make_shared<NodeH>(name.str(), hIndex,
                                                      posHoriz, posVerti));
+    problem.nodeHs.back()->address = {
+        static_cast<unsigned>(boardOuterIdx * boardInnerRange + boardInnerIdx),
+        static_cast<unsigned>(mboxOuterIdx * mboxInnerRange + mboxInnerIdx),
+        static_cast<unsigned>(coreIdx)};
     hIndexGivenPos[{boardOuterIdx, boardInnerIdx,
                     mboxOuterIdx, mboxInnerIdx, coreIdx}] = hIndex;
 }}}}}
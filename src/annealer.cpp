@@ -1,10 +1,16 @@
 #include "annealer.hpp"
 
+#include "binary_io.hpp"
+
 /* Macros for parsing the git revision preprocessor argument (if any) */
 #define STRINGIFY(x) #x
 
+#include <algorithm>
+#include <cmath>
 #include <iomanip>
+#include <sstream>
 #include <utility>
+#include <vector>
 
 template<class DisorderT>
 Annealer<DisorderT>::Annealer(Iteration maxIterationArg,
@@ -19,6 +25,481 @@ Annealer<DisorderT>::Annealer(Iteration maxIterationArg,
     log = !outDir.empty();
 }
 
+/* Causes anneals to begin `fraction` of the way through the disorder schedule
+ * (i.e. with less disorder), running only for the remainder of the maximum
+ * number of iterations. Fractions are clamped to [0, 1). */
+template<class DisorderT>
+void Annealer<DisorderT>::warm_start(double fraction)
+{
+    warmStartFraction = std::clamp(fraction, 0.0, 1.0);
+    firstIteration = static_cast<Iteration>(warmStartFraction *
+                                            static_cast<double>(maxIteration));
+    if (maxIteration > 0)
+        firstIteration = std::min(firstIteration, maxIteration - 1);
+}
+
+/* Stops the anneal once the best fitness seen has not improved for `window`
+ * iterations. In a parallel anneal, each worker tracks the fitness it sees
+ * (which drifts from the true fitness in the semi-asynchronous mode), and the
+ * anneal stops once every worker has stagnated. Zero disables. */
+template<class DisorderT>
+void Annealer<DisorderT>::stop_on_stagnation(Iteration window)
+{
+    stagnationWindow = window;
+}
+
+/* Stops the anneal once fewer than `threshold` (a fraction) of the
+ * transformations in a window of `window` consecutive iterations are
+ * accepted. In a parallel anneal, windows are per-worker, and the anneal stops
+ * once every worker has seen a low acceptance rate. Zero disables. */
+template<class DisorderT>
+void Annealer<DisorderT>::stop_on_low_acceptance(double threshold,
+                                                 Iteration window)
+{
+    acceptanceThreshold = threshold;
+    acceptanceWindow = window;
+}
+
+/* Stops the anneal once the fitness reaches `target`. In a parallel anneal,
+ * the first worker to see it stops everyone (note that fitness drifts in the
+ * semi-asynchronous mode). */
+template<class DisorderT>
+void Annealer<DisorderT>::stop_on_target(float target)
+{
+    useTargetFitness = true;
+    targetFitness = target;
+}
+
+/* Runs anneals for `seconds` of wall-clock time, regardless of the number of
+ * iterations. The disorder schedule is driven by the elapsed fraction of the
+ * budget (as if that fraction of maxIteration had passed), measured once
+ * every `sampleEvery` iterations by each worker. Zero seconds disables. */
+template<class DisorderT>
+void Annealer<DisorderT>::run_for(double seconds, Iteration sampleEvery)
+{
+    timeBudget = std::max(seconds, 0.0);
+    clockSampleEvery = std::max<Iteration>(sampleEvery, 1);
+}
+
+/* Calibrates the disorder schedule from the initial condition at the start of
+ * each anneal, so that inferior solutions are accepted with mean probability
+ * `startAcceptanceArg` at the start of the anneal, and `endAcceptanceArg` at
+ * the end. The probabilities are estimated from `samples` random
+ * transformations. Only schedules with a calibrate method are calibrated. */
+template<class DisorderT>
+void Annealer<DisorderT>::calibrate(double startAcceptanceArg,
+                                    double endAcceptanceArg, unsigned samples)
+{
+    startAcceptance = std::clamp(startAcceptanceArg, 1e-9, 1 - 1e-9);
+    endAcceptance = std::clamp(endAcceptanceArg, 1e-9, 1 - 1e-9);
+    calibrationSamples = samples;
+}
+
+/* Samples random transformations from the current state of the problem
+ * (reverting each one), and finds the temperatures at which the mean
+ * acceptance probability of the inferior ones hits the targets (by bisection
+ * over the logarithm of temperature, because acceptance increases
+ * monotonically with it). Then calibrates the disorder schedule with them.
+ * Not thread safe. */
+template<class DisorderT>
+void Annealer<DisorderT>::calibrate_disorder(Problem& problem)
+{
+    if constexpr (!requires(DisorderT schedule){schedule.calibrate(1.0, 1.0);})
+    {
+        problem.log("Disorder schedule cannot be calibrated - skipping.");
+        return;
+    }
+    else
+    {
+        auto selA = problem.nodeAs.begin();
+        auto selH = problem.nodeHs.begin();
+        auto oldH = problem.nodeHs.begin();
+        std::vector<double> differences;
+        for (unsigned sample = 0; sample < calibrationSamples; sample++)
+        {
+            problem.select_serial(selA, selH, oldH);
+            auto oldComponents =
+                problem.compute_hw_node_clustering_fitness(**selH) +
+                problem.compute_hw_node_clustering_fitness(**oldH) +
+                problem.compute_app_node_locality_fitness(**selA) * 2;
+            problem.transform(selA, selH, oldH);
+            auto newComponents =
+                problem.compute_hw_node_clustering_fitness(**selH) +
+                problem.compute_hw_node_clustering_fitness(**oldH) +
+                problem.compute_app_node_locality_fitness(**selA) * 2;
+            problem.transform(selA, oldH, selH);
+            if (newComponents < oldComponents)
+                differences.push_back(oldComponents - newComponents);
+        }
+
+        if (differences.empty())
+        {
+            problem.log("No inferior transformations sampled during "
+                        "calibration - skipping.");
+            return;
+        }
+
+        auto temperatureFor = [&differences](double acceptance)
+        {
+            double low = std::log(*std::min_element(differences.begin(),
+                                                    differences.end())) - 20;
+            double high = std::log(*std::max_element(differences.begin(),
+                                                     differences.end())) + 20;
+            for (unsigned step = 0; step < 64; step++)
+            {
+                double middle = (low + high) / 2;
+                double meanAcceptance = 0;
+                for (const auto& difference : differences)
+                    meanAcceptance += std::exp(-difference /
+                                               std::exp(middle));
+                meanAcceptance /= static_cast<double>(differences.size());
+                if (meanAcceptance < acceptance) low = middle;
+                else high = middle;
+            }
+            return std::exp((low + high) / 2);
+        };
+
+        startTemperature = temperatureFor(startAcceptance);
+        endTemperature = temperatureFor(endAcceptance);
+        disorder.calibrate(startTemperature, endTemperature);
+
+        std::stringstream message;
+        message << "Disorder calibrated from " << differences.size()
+                << " inferior transformation(s): temperature "
+                << startTemperature << " to " << endTemperature << ".";
+        problem.log(message.str());
+    }
+}
+
+/* Snapshots the state every `checkpointEveryArg` iterations if it is the
+ * best seen so far (by true fitness), and leaves the best state in the
+ * problem at the end of the anneal (instead of the last one). Snapshots are
+ * arrays of locations (see Problem::snapshot_locations), so the cost of
+ * retention is O(|A|) per checkpoint. Zero disables. */
+template<class DisorderT>
+void Annealer<DisorderT>::retain_best(Iteration checkpointEveryArg)
+{
+    checkpointEvery = checkpointEveryArg;
+}
+
+/* Once the best state has not improved for `window` iterations (as measured
+ * at checkpoints, so requires retain_best), moves the disorder schedule back
+ * to `fraction` of the way through (if it has got further than that), and
+ * restarts from the best state if `restartFromBestArg`. The rest of the
+ * anneal (iterations, or time if on a budget) then covers the schedule from
+ * there to the end, so the anneal still ends cold. Zero disables. */
+template<class DisorderT>
+void Annealer<DisorderT>::reheat_on_stagnation(Iteration window,
+                                               double fraction,
+                                               bool restartFromBestArg)
+{
+    reheatWindow = window;
+    reheatFraction = std::clamp(fraction, 0.0, 1.0);
+    restartFromBest = restartFromBestArg;
+}
+
+/* Writes a snapshot of the placement to the "snapshots" directory in the
+ * output directory every `seconds` seconds of an anneal, from a background
+ * thread (see Snapshotter), and once more at the end. Workers don't stop for
+ * snapshots, but pay a relaxed store per transformation while they are being
+ * taken. Only applies if the output path is defined. Zero disables. */
+template<class DisorderT>
+void Annealer<DisorderT>::snapshot_every(double seconds)
+{
+    snapshotPeriod = std::max(seconds, 0.0);
+}
+
+/* Starts snapshotting, if we've been asked to. */
+template<class DisorderT>
+void Annealer<DisorderT>::begin_snapshots(
+    Problem& problem, const std::atomic<Iteration>& progress)
+{
+    if (snapshotPeriod == 0 or !log) return;
+    snapshotter = std::make_unique<Snapshotter>(
+        problem, outDir / snapshotDirName, snapshotPeriod, progress);
+}
+
+/* Takes the last snapshot and stops snapshotting. Workers must have
+ * stopped. */
+template<class DisorderT>
+void Annealer<DisorderT>::end_snapshots()
+{
+    snapshotter.reset();
+}
+
+/* Saves the state of anneals to "resume.bin" in the output directory every
+ * `every` iterations (replacing the previous save atomically), so that a
+ * killed anneal can be resumed with resume_from. Only applies if the output
+ * path is defined. Zero disables. */
+template<class DisorderT>
+void Annealer<DisorderT>::save_resume_every(Iteration every)
+{
+    resumeEvery = every;
+}
+
+/* Resumes the next anneal from a state saved by save_resume_every, instead of
+ * from the placement of the problem. The problem must be defined as it was
+ * for the saved anneal, and the annealer configured as it was. A serial
+ * anneal resumes exactly (the resumed anneal ends as the saved one would
+ * have). A parallel anneal resumes from the same placement, fitness and
+ * schedule position, but the order in which workers interleave can't be
+ * saved (nor can their unused thresholds), so only its statistics carry on.
+ * Time budgets restart. */
+template<class DisorderT>
+void Annealer<DisorderT>::resume_from(const std::filesystem::path& path)
+{
+    resumePath = path;
+}
+
+/* Writes the resume file. Bulky parts (the placement and the best placement)
+ * are written as flat arrays, so that they load in one read each. */
+template<class DisorderT>
+void Annealer<DisorderT>::save_resume(
+    Problem& problem, Iteration iteration, ExactFitness clusteringFitness,
+    ExactFitness localityFitness, std::span<const Convergence> convergences)
+{
+    if (!log) return;
+    std::vector<unsigned> locations;
+    problem.snapshot_locations(locations);
+    bool written = write_atomically(
+        outDir / resumeName, [&](std::ostream& out)
+    {
+        out.write(resumeMagic, sizeof(resumeMagic));
+        write_binary(out, resumeVersion);
+        write_binary(out, std::uint32_t(0));  /* Reserved */
+        write_binary(out, iteration);
+        write_binary(out, clusteringFitness);
+        write_binary(out, localityFitness);
+        write_binary(out, locations);
+
+        write_binary(out, bestLocations);
+        write_binary(out, bestFitness);
+        write_binary(out, lastImprovement);
+        write_binary(out, reheatFrom);
+        write_binary(out, reheatTo);
+        write_binary(out, reheatScale);
+        write_binary(out, reheats);
+
+        write_binary(out, std::uint64_t(convergences.size()));
+        for (const auto& convergence : convergences)
+        {
+            write_binary(out, convergence.bestFitness);
+            write_binary(out, convergence.sinceImprovement);
+            write_binary(out, convergence.windowLength);
+            write_binary(out, convergence.windowAcceptances);
+            write_binary(out, convergence.voted);
+        }
+
+        problem.save_rng(out);
+        if constexpr (requires(DisorderT schedule, std::ostream& stream)
+                      {schedule.save_state(stream);})
+            disorder.save_state(out);
+    });
+
+    if (!written)
+        problem.log("Failed to write resume file " +
+                    (outDir / resumeName).string() + ".");
+}
+
+/* Reads the resume file given to resume_from (once), and restores the
+ * problem and annealer from it. The file is checked before anything is
+ * restored (that its placements are valid for the problem, that its
+ * iteration is within the anneal, and that its lengths fit in the file),
+ * except for randomness, which comes last. Workers beyond those saved start
+ * afresh, and extra saved workers are dropped. */
+template<class DisorderT>
+bool Annealer<DisorderT>::load_resume(
+    Problem& problem, Iteration& iteration, ExactFitness& clusteringFitness,
+    ExactFitness& localityFitness, std::span<Convergence> convergences)
+{
+    if (!resuming()) return false;
+    auto path = std::move(resumePath);
+    resumePath.clear();
+
+    std::ifstream in(path, std::ifstream::binary);
+    char fileMagic[sizeof(resumeMagic)];
+    std::uint32_t fileVersion;
+    std::uint32_t reserved;
+    Iteration fileIteration;
+    ExactFitness fileClusteringFitness;
+    ExactFitness fileLocalityFitness;
+    std::vector<unsigned> locations;
+    std::vector<unsigned> fileBestLocations;
+    float fileBestFitness;
+    Iteration fileLastImprovement;
+    Iteration fileReheatFrom;
+    Iteration fileReheatTo;
+    double fileReheatScale;
+    unsigned fileReheats;
+    std::uint64_t savedWorkers;
+    constexpr auto convergenceBytes = sizeof(Convergence::bestFitness) +
+        sizeof(Convergence::sinceImprovement) +
+        sizeof(Convergence::windowLength) +
+        sizeof(Convergence::windowAcceptances) +
+        sizeof(Convergence::voted);
+    in.read(fileMagic, sizeof(fileMagic));
+    bool valid = read_binary(in, fileVersion) and
+        read_binary(in, reserved) and
+        std::equal(resumeMagic, resumeMagic + sizeof(resumeMagic),
+                   fileMagic) and
+        fileVersion == resumeVersion and
+        read_binary(in, fileIteration) and
+        read_binary(in, fileClusteringFitness) and
+        read_binary(in, fileLocalityFitness) and
+        fileIteration >= firstIteration and
+        fileIteration < end_iteration() and
+        read_binary(in, locations) and
+        problem.valid_locations(locations) and
+        read_binary(in, fileBestLocations) and
+        (checkpointEvery == 0 ? fileBestLocations.empty() :
+         problem.valid_locations(fileBestLocations)) and
+        read_binary(in, fileBestFitness) and
+        read_binary(in, fileLastImprovement) and
+        read_binary(in, fileReheatFrom) and
+        read_binary(in, fileReheatTo) and
+        read_binary(in, fileReheatScale) and
+        read_binary(in, fileReheats) and
+        read_binary(in, savedWorkers) and
+        savedWorkers <= remaining_bytes(in) / convergenceBytes;
+
+    std::vector<Convergence> fileConvergences(valid ? savedWorkers : 0);
+    for (auto& convergence : fileConvergences)
+        valid = valid and read_binary(in, convergence.bestFitness) and
+            read_binary(in, convergence.sinceImprovement) and
+            read_binary(in, convergence.windowLength) and
+            read_binary(in, convergence.windowAcceptances) and
+            read_binary(in, convergence.voted);
+
+    if (!valid)
+    {
+        problem.log("Could not resume from " + path.string() +
+                    " (not a resume file, or not for this problem) - "
+                    "starting afresh.");
+        return false;
+    }
+
+    iteration = fileIteration;
+    clusteringFitness = fileClusteringFitness;
+    localityFitness = fileLocalityFitness;
+    problem.restore_locations(locations);
+    bestLocations = std::move(fileBestLocations);
+    bestFitness = fileBestFitness;
+    lastImprovement = fileLastImprovement;
+    reheatFrom = fileReheatFrom;
+    reheatTo = fileReheatTo;
+    reheatScale = fileReheatScale;
+    reheats = fileReheats;
+    for (std::size_t index = 0; index < convergences.size(); index++)
+        convergences[index] = index < fileConvergences.size() ?
+            fileConvergences[index] : Convergence{};
+
+    valid = problem.load_rng(in);
+    if constexpr (requires(DisorderT schedule, std::istream& stream)
+                  {schedule.load_state(stream);})
+        valid = valid and disorder.load_state(in);
+
+    std::stringstream message;
+    message << "Resumed from " << path.string() << " at iteration "
+            << iteration << ".";
+    if (!valid) message << " Randomness could not be restored, so the "
+                        << "anneal will not carry on exactly.";
+    problem.log(message.str());
+    return true;
+}
+
+/* Takes the first snapshot, at the start of the anneal. */
+template<class DisorderT>
+void Annealer<DisorderT>::begin_retention(Problem& problem,
+                                          Iteration iteration)
+{
+    reheatFrom = 0;
+    reheatTo = 0;
+    reheatScale = 1;
+    reheats = 0;
+    if (checkpointEvery == 0) return;
+    problem.snapshot_locations(bestLocations);
+    bestFitness = problem.compute_total_fitness();
+    lastImprovement = iteration;
+}
+
+/* Called every checkpointEvery iterations, while no workers are
+ * transforming. Snapshots the state if it is the best seen, and reheats if
+ * the best has not improved for too long. Returns true if the state has been
+ * restored, in which case callers must recompute their fitness. */
+template<class DisorderT>
+bool Annealer<DisorderT>::checkpoint(Problem& problem, float fitness,
+                                     Iteration iteration,
+                                     Iteration schedulePosition)
+{
+    if (fitness > bestFitness)
+    {
+        problem.snapshot_locations(bestLocations);
+        bestFitness = fitness;
+        lastImprovement = iteration;
+        return false;
+    }
+
+    if (reheatWindow == 0 or iteration - lastImprovement < reheatWindow)
+        return false;
+
+    /* Reheat, if we're colder than we'd reheat to, and stretch the rest of
+     * the anneal back over the schedule from there. */
+    lastImprovement = iteration;
+    auto reheatTarget = static_cast<Iteration>(
+        reheatFraction * static_cast<double>(maxIteration));
+    if (reheated(schedulePosition) > reheatTarget and
+        schedulePosition < maxIteration)
+    {
+        reheatFrom = schedulePosition;
+        reheatTo = reheatTarget;
+        reheatScale = static_cast<double>(maxIteration - reheatTo) /
+            static_cast<double>(maxIteration - reheatFrom);
+    }
+    reheats++;
+
+    std::stringstream message;
+    message << "Reheating at iteration " << iteration << " to schedule "
+            << "iteration " << reheatTarget;
+    if (restartFromBest) message << ", from the best state (fitness "
+                                 << bestFitness << ")";
+    message << ".";
+    problem.log(message.str());
+
+    if (!restartFromBest) return false;
+    problem.restore_locations(bestLocations);
+    return true;
+}
+
+/* Restores the best state, if the final one is worse. */
+template<class DisorderT>
+void Annealer<DisorderT>::end_retention(Problem& problem)
+{
+    if (checkpointEvery == 0) return;
+    auto finalFitness = problem.compute_total_fitness();
+    if (finalFitness >= bestFitness) return;
+    problem.restore_locations(bestLocations);
+
+    std::stringstream message;
+    message << "Restored best state (fitness " << bestFitness
+            << ", instead of " << finalFitness << ") after " << reheats
+            << " reheat(s).";
+    problem.log(message.str());
+}
+
+template<class DisorderT>
+const char* Annealer<DisorderT>::describe(StopReason reason)
+{
+    switch (reason)
+    {
+    case StopReason::stagnation: return "fitness stagnated";
+    case StopReason::lowAcceptance: return "acceptance rate fell below "
+                                           "threshold";
+    case StopReason::target: return "target fitness reached";
+    case StopReason::budgetSpent: return "time budget spent";
+    default: return "not stopped";
+    }
+}
+
 /* Writes metadata to the (INI) metadata file, but only if the output path is
  * defined. */
 template<class DisorderT>
@@ -40,7 +521,22 @@ void Annealer<DisorderT>::write_metadata()
                  << "annealerType = " << handle << std::endl
                  << "disorderType = " << disorder.handle << std::endl
                  << "gitRevision = " << gitRevision << std::endl
-                 << "now = " << std::put_time(std::gmtime(&datetime),
+                 << "firstIteration = " << firstIteration << std::endl
+                 << "stagnationWindow = " << stagnationWindow << std::endl
+                 << "acceptanceThreshold = " << acceptanceThreshold
+                 << std::endl
+                 << "acceptanceWindow = " << acceptanceWindow << std::endl
+                 << "timeBudget = " << timeBudget << std::endl
+                 << "checkpointEvery = " << checkpointEvery << std::endl
+                 << "reheatWindow = " << reheatWindow << std::endl
+                 << "snapshotPeriod = " << snapshotPeriod << std::endl
+                 << "resumeEvery = " << resumeEvery << std::endl;
+        if (startTemperature > 0)
+            metadata << "startTemperature = " << startTemperature << std::endl
+                     << "endTemperature = " << endTemperature << std::endl;
+        if (useTargetFitness)
+            metadata << "targetFitness = " << targetFitness << std::endl;
+        metadata << "now = " << std::put_time(std::gmtime(&datetime),
                                               "%FT%T%z") << std::endl;
         metadata.close();
     }
@@ -1,14 +1,107 @@
 #include "disorder_schedules.hpp"
 
+#include "binary_io.hpp"
+
+#include <algorithm>
 #include <cmath>
+#include <limits>
+
+/* Per-worker state, belonging to one schedule (`owner`) at a time:
+ * acceptance thresholds for Disorder::accept_inferior, and acceptance windows
+ * for AdaptiveDisorder::record. */
+struct ThresholdBatch
+{
+    unsigned long long owner = 0;
+    std::array<double, 256> thresholds;
+    unsigned next = 256;
+};
+static thread_local ThresholdBatch batch;
+
+struct AcceptanceWindow
+{
+    unsigned long long owner = 0;
+    unsigned moves = 0;
+    unsigned acceptances = 0;
+};
+static thread_local AcceptanceWindow window;
 
 Disorder::Disorder(Iteration maxIteration, Seed seed):
-    maxIteration(maxIteration)
+    maxIteration(maxIteration),
+    temperatureRefresh(std::clamp(maxIteration / 1000, Iteration(1),
+                                  maxTemperatureRefresh))
 {
     /* Define our random number generator. */
     rng = Prng(determine_seed(seed));
 }
 
+/* Decides whether to accept an inferior solution, `fitnessDifference` worse
+ * than the current one, at a temperature. The textbook test, u <
+ * exp(-difference / temperature) for uniform u, is equivalent to difference <
+ * temperature * -log(u), where -log(u) is exponentially distributed. So:
+ *
+ * - Differences beyond the cutoff are rejected outright, without drawing.
+ *
+ * - Thresholds (-log(u)) are drawn in batches per worker, and each
+ *   determination costs a multiply and a compare. */
+bool Disorder::accept_inferior(double fitnessDifference, double temperature)
+{
+    if (!(fitnessDifference < acceptanceCutoff * temperature)) return false;
+
+    /* (The batch is sized at file scope.) */
+    static_assert(std::tuple_size_v<decltype(batch.thresholds)> ==
+                  thresholdBatchSize);
+    if (batch.owner != instance)
+    {
+        batch.owner = instance;
+        batch.next = thresholdBatchSize;
+    }
+
+    if (batch.next == thresholdBatchSize)
+    {
+        for (auto& threshold : batch.thresholds)
+            threshold = -std::log(1 - distribution(rng));
+        batch.next = 0;
+    }
+    return fitnessDifference < temperature * batch.thresholds[batch.next++];
+}
+
+/* Returns a value of the schedule (from `Compute`), held constant for each
+ * worker over runs of temperatureRefresh iterations at its value in the
+ * middle of the run. Sampling the middle (rather than the start) keeps the
+ * held value close to the schedule on average, and away from the (possibly
+ * infinite) temperature of iteration zero. Each `Compute` has its own
+ * cache. */
+template <double (Disorder::*Compute)(Iteration)>
+double Disorder::cached(Iteration iteration)
+{
+    struct Cache
+    {
+        unsigned long long owner = 0;
+        Iteration piece = 0;
+        double value = 0;
+    };
+    static thread_local Cache cache;
+    auto piece = iteration / temperatureRefresh;
+    if (cache.owner != instance or cache.piece != piece)
+        cache = Cache{instance, piece,
+                      (this->*Compute)(piece * temperatureRefresh +
+                                       temperatureRefresh / 2)};
+    return cache.value;
+}
+
+/* The temperature of the schedule (see compute_temperature), and the shift
+ * applied to differences by schedules that scale the acceptance probability
+ * instead (see compute_shift), held as above. */
+double Disorder::cached_temperature(Iteration iteration)
+{
+    return cached<&Disorder::compute_temperature>(iteration);
+}
+
+double Disorder::cached_shift(Iteration iteration)
+{
+    return cached<&Disorder::compute_shift>(iteration);
+}
+
 /* Constructors for non-virtual classes define fields that are effectively
  * constant for the lifetime of the object. */
 NoDisorder::NoDisorder(Iteration maxIteration, Seed seed):
@@ -20,6 +113,9 @@ ExpDecayDisorder::ExpDecayDisorder(Iteration maxIteration, Seed seed):
     disorderDecay = std::log(0.5) / (maxIteration / 2.5);
 }
 
+AdaptiveDisorder::AdaptiveDisorder(Iteration maxIteration, Seed seed):
+    Disorder::Disorder(maxIteration, seed){}
+
 LinearDecayDisorder::LinearDecayDisorder(Iteration maxIteration, Seed seed):
     Disorder::Disorder(maxIteration, seed)
 {
@@ -27,6 +123,57 @@ LinearDecayDisorder::LinearDecayDisorder(Iteration maxIteration, Seed seed):
     intercept = 0.5;
 }
 
+/* 'Calibrate' methods redefine schedules in terms of the temperatures at the
+ * start and end of the anneal. The exponential decay schedule keeps its shape
+ * (reciprocal temperature linear in the iteration). */
+void ExpDecayDisorder::calibrate(double startTemperature,
+                                 double endTemperature)
+{
+    disorderOffset = -1 / startTemperature;
+    disorderDecay = (1 / startTemperature - 1 / endTemperature) /
+        static_cast<double>(maxIteration);
+}
+
+/* Once calibrated, temperature decays linearly (from the intercept to zero
+ * before calibration). */
+void LinearDecayDisorder::calibrate(double startTemperature,
+                                    double endTemperature)
+{
+    calibrated = true;
+    intercept = startTemperature;
+    gradient = (endTemperature - startTemperature) /
+        static_cast<double>(maxIteration);
+}
+
+/* 'Compute temperature' methods define temperature over the schedule, for
+ * cached_temperature. */
+double ExpDecayDisorder::compute_temperature(Iteration iteration)
+{
+    auto temperatureReciprocal = -(disorderOffset + disorderDecay * iteration);
+    if (temperatureReciprocal <= 0)
+        return std::numeric_limits<double>::infinity();
+    return 1 / temperatureReciprocal;
+}
+
+double LinearDecayDisorder::compute_temperature(Iteration iteration)
+{
+    return intercept + gradient * iteration;
+}
+
+/* Uncalibrated, this schedule scales the acceptance probability by the
+ * decay instead, which shifts the difference (in units of temperature) by
+ * the log of the decay. */
+double LinearDecayDisorder::compute_shift(Iteration iteration)
+{
+    return std::log(intercept + gradient * iteration);
+}
+
+/* Adaptive disorder finds its own way to the end - only the start matters. */
+void AdaptiveDisorder::calibrate(double startTemperature, double)
+{
+    temperature = startTemperature;
+}
+
 /* 'Determine' methods all determine whether to select a new solution, given
  * values for the old fitness and the new fitness, and the current
  * iteration. Always accept a superior solution.
@@ -36,23 +183,155 @@ bool ExpDecayDisorder::determine(float oldFitness, float newFitness,
                                  Iteration iteration)
 {
     if (oldFitness < newFitness) return true;
-    auto fitnessDifference = oldFitness - newFitness;
-    auto temperatureReciprocal = disorderDecay * iteration;
-    auto acceptProb = std::exp(fitnessDifference * temperatureReciprocal);
-    return distribution(rng) < acceptProb;
+    return accept_inferior(oldFitness - newFitness,
+                           cached_temperature(iteration));
 }
 
 bool LinearDecayDisorder::determine(float oldFitness, float newFitness,
                                     Iteration iteration)
 {
     if (oldFitness < newFitness) return true;
-    auto fitnessDifference = oldFitness - newFitness;
-    auto decay = intercept + gradient * iteration;
-    auto acceptProb = std::exp(-fitnessDifference) * decay;
-    return distribution(rng) < acceptProb;
+    double fitnessDifference = oldFitness - newFitness;
+    if (calibrated)
+        return accept_inferior(fitnessDifference,
+                               cached_temperature(iteration));
+
+    /* Uncalibrated, this schedule scales the acceptance probability instead
+     * of the temperature (see compute_shift). */
+    return accept_inferior(fitnessDifference - cached_shift(iteration), 1);
+}
+
+bool AdaptiveDisorder::determine(float oldFitness, float newFitness,
+                                 Iteration iteration)
+{
+    bool accepted = oldFitness < newFitness;
+    if (!accepted)
+    {
+        double fitnessDifference = oldFitness - newFitness;
+
+        /* Start hot enough to accept this one a third of the time. */
+        double expected = 0;
+        if (fitnessDifference > 0)
+            temperature.compare_exchange_strong(expected, fitnessDifference,
+                                                std::memory_order_relaxed);
+
+        accepted = accept_inferior(
+            fitnessDifference, temperature.load(std::memory_order_relaxed));
+    }
+    record(accepted, iteration);
+    return accepted;
+}
+
+/* The target acceptance rate for a point in the anneal, after the modified
+ * Lam schedule (Swartz, 1993): decays exponentially from one to the plateau,
+ * holds, then decays exponentially to a thousandth of the plateau by the
+ * end. */
+double AdaptiveDisorder::target_acceptance(Iteration iteration)
+{
+    auto fraction = static_cast<double>(iteration) /
+        static_cast<double>(maxIteration);
+    if (fraction < plateauStart)
+        return plateauAcceptance + (1 - plateauAcceptance) *
+            std::pow(560, -fraction / plateauStart);
+    if (fraction < plateauEnd) return plateauAcceptance;
+    return plateauAcceptance *
+        std::pow(1000, -(fraction - plateauEnd) / (1 - plateauEnd));
+}
+
+/* Counts an outcome against the calling worker's window, and steers the
+ * temperature at the end of the window. Windows are thread-local, and belong
+ * to one schedule at a time. Steps are multiplicative, so concurrent steps
+ * from different workers commute. */
+void AdaptiveDisorder::record(bool accepted, Iteration iteration)
+{
+    if (window.owner != instance) window = AcceptanceWindow{instance, 0, 0};
+
+    window.acceptances += accepted;
+    if (++window.moves < windowSize) return;
+    auto rate = static_cast<double>(window.acceptances) / window.moves;
+    window.moves = 0;
+    window.acceptances = 0;
+
+    auto step = rate > target_acceptance(iteration) ?
+        temperatureStep : 1 / temperatureStep;
+    auto current = temperature.load(std::memory_order_relaxed);
+    while (!temperature.compare_exchange_weak(current, current * step,
+                                              std::memory_order_relaxed));
 }
 
 bool NoDisorder::determine(float oldFitness, float newFitness, Iteration)
 {
     return oldFitness < newFitness;
 }
+
+/* 'Save state' and 'load state' methods write and read what a schedule needs
+ * to carry on exactly where it left off: the generator, the calling thread's
+ * unused thresholds (other threads' thresholds are lost, and redrawn), and
+ * any parameters set by calibration. */
+void Disorder::save_state(std::ostream& out)
+{
+    write_binary(out, rng);
+    unsigned next = batch.owner == instance ? batch.next : thresholdBatchSize;
+    write_binary(out, next);
+    for (auto index = next; index < thresholdBatchSize; index++)
+        write_binary(out, batch.thresholds[index]);
+}
+
+bool Disorder::load_state(std::istream& in)
+{
+    unsigned next;
+    if (!read_binary(in, rng) or !read_binary(in, next) or
+        next > thresholdBatchSize) return false;
+    batch.owner = instance;
+    batch.next = next;
+    for (auto index = next; index < thresholdBatchSize; index++)
+        if (!read_binary(in, batch.thresholds[index])) return false;
+    return true;
+}
+
+void ExpDecayDisorder::save_state(std::ostream& out)
+{
+    Disorder::save_state(out);
+    write_binary(out, disorderDecay);
+    write_binary(out, disorderOffset);
+}
+
+bool ExpDecayDisorder::load_state(std::istream& in)
+{
+    return Disorder::load_state(in) and read_binary(in, disorderDecay) and
+        read_binary(in, disorderOffset);
+}
+
+void LinearDecayDisorder::save_state(std::ostream& out)
+{
+    Disorder::save_state(out);
+    write_binary(out, gradient);
+    write_binary(out, intercept);
+    write_binary(out, calibrated);
+}
+
+bool LinearDecayDisorder::load_state(std::istream& in)
+{
+    return Disorder::load_state(in) and read_binary(in, gradient) and
+        read_binary(in, intercept) and read_binary(in, calibrated);
+}
+
+void AdaptiveDisorder::save_state(std::ostream& out)
+{
+    Disorder::save_state(out);
+    write_binary(out, temperature.load());
+    bool owned = window.owner == instance;
+    write_binary(out, owned ? window.moves : 0u);
+    write_binary(out, owned ? window.acceptances : 0u);
+}
+
+bool AdaptiveDisorder::load_state(std::istream& in)
+{
+    double savedTemperature;
+    if (!Disorder::load_state(in) or !read_binary(in, savedTemperature) or
+        !read_binary(in, window.moves) or
+        !read_binary(in, window.acceptances)) return false;
+    temperature = savedTemperature;
+    window.owner = instance;
+    return true;
+}
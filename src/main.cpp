@@ -1,32 +1,272 @@
 #include "problem_definition_wrapper.hpp"
+#include "build_helpers.hpp"
 #include "parallel_annealer.hpp"
 #include "serial_annealer.hpp"
+#include "staged_annealer.hpp"
 
+#include <chrono>
+#include <cmath>
 #include <filesystem>
 #include <iostream>
+#include <string>
+#include <type_traits>
 
-int main()
+/* Command-line options override the config in main_config.hpp. */
+static void print_usage(const char* program)
+{
+    std::cerr
+        << "Usage: " << program << " [OPTION]...\n"
+        << "Anneals a placement problem configured by main_config.hpp, with "
+        << "these overrides:\n"
+        << "  --mode MODE       serial, parallel, or staged\n"
+        << "  --workers N       number of workers (parallel or staged)\n"
+        << "  --sync, --async   fully-synchronous or semi-asynchronous "
+        << "(parallel)\n"
+        << "  --seed SEED       seed all generators with SEED\n"
+        << "  --iterations N    number of iterations (e.g. 5e9)\n"
+        << "  --schedule NAME   exp, linear, adaptive, none, or zero\n"
+        << "  --initial NAME    bucket, curve, partition, or random\n"
+        << "  --time SECONDS    anneal for this long instead (serial or "
+        << "parallel)\n"
+        << "  --problem PATH    load the problem from a problem file\n"
+        << "  --generate SPEC   generate the problem from a spec\n"
+        << "  --out DIR         write output to DIR/<problem name>\n"
+        << "  --mouse           mouse mode (timing only, no output files)\n"
+        << "  --sweep SPEC      anneal once per combination in SPEC (see "
+        << "main_config.hpp)\n"
+        << "  --help            print this and exit\n";
+}
+
+/* Iteration counts may be written in scientific notation, as long as they
+ * are whole. */
+static bool parse_iterations(std::string_view field, Iteration& value)
+{
+    double parsed;
+    if (parse_field(field, value)) return true;
+    if (!parse_field(field, parsed) or !(parsed >= 0) or
+        parsed != std::floor(parsed) or
+        parsed > static_cast<double>(std::numeric_limits<Iteration>::max()))
+        return false;
+    value = static_cast<Iteration>(parsed);
+    return true;
+}
+
+static bool is_schedule(std::string_view name)
+{
+    return name == "exp" or name == "linear" or name == "adaptive" or
+        name == "none" or name == "zero";
+}
+
+/* Parameters of a sweep (see sweepSpec in main_config.hpp), each a list of
+ * values to sweep over. */
+struct SweepSpec
+{
+    std::vector<std::string> modes;
+    std::vector<unsigned> workers;
+    std::vector<bool> synchronous;
+    std::vector<Seed> seeds;
+    std::vector<std::string> schedules;
+    unsigned repeats = 1;
+};
+
+/* Parses a sweep spec over `spec`, which holds the defaults, writing the
+ * first problem to `errors`. */
+static bool parse_sweep(std::string_view text, SweepSpec& spec,
+                        std::stringstream& errors)
+{
+    std::vector<std::string_view> fields;
+    std::vector<std::string_view> values;
+    split_fields(text, fields);
+    for (const auto& field : fields)
+    {
+        auto equals = field.find('=');
+        auto key = field.substr(0, equals);
+        values.clear();
+        if (equals != std::string_view::npos)
+        {
+            auto list = field.substr(equals + 1);
+            while (true)
+            {
+                auto comma = list.find(',');
+                values.push_back(list.substr(0, comma));
+                if (comma == std::string_view::npos) break;
+                list.remove_prefix(comma + 1);
+            }
+        }
+
+        bool valid = !values.empty();
+        if (key == "modes") spec.modes.clear();
+        else if (key == "workers") spec.workers.clear();
+        else if (key == "sync") spec.synchronous.clear();
+        else if (key == "seeds") spec.seeds.clear();
+        else if (key == "schedules") spec.schedules.clear();
+        else if (key == "repeats")
+            valid = values.size() == 1 and
+                parse_field(values.front(), spec.repeats) and
+                spec.repeats > 0;
+        else
+        {
+            errors << "Sweep spec has unknown key '" << key << "'.\n";
+            return false;
+        }
+
+        for (const auto& value : values)
+        {
+            unsigned number;
+            Seed seed;
+            if (key == "modes")
+            {
+                spec.modes.emplace_back(value);
+                valid = valid and (value == "serial" or
+                                   value == "parallel" or value == "staged");
+            }
+            else if (key == "workers")
+                valid = valid and parse_field(value, number) and
+                    number > 0 and (spec.workers.push_back(number), true);
+            else if (key == "sync")
+                valid = valid and parse_field(value, number) and
+                    number <= 1 and
+                    (spec.synchronous.push_back(number == 1), true);
+            else if (key == "seeds")
+                valid = valid and parse_field(value, seed) and
+                    (spec.seeds.push_back(seed), true);
+            else if (key == "schedules")
+            {
+                spec.schedules.emplace_back(value);
+                valid = valid and is_schedule(value);
+            }
+        }
+
+        if (!valid)
+        {
+            errors << "Sweep spec has a bad value for key '" << key
+                   << "'.\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
 {
     /* Life's too short. */
 #include "main_config.hpp"
 
+    /* Command-line overrides. */
+    for (int index = 1; index < argc; index++)
+    {
+        std::string_view option = argv[index];
+        if (option == "--help")
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+
+        bool valid = true;
+        if (option == "--sync") fullySynchronous = true;
+        else if (option == "--async") fullySynchronous = false;
+        else if (option == "--mouse") mouseMode = true;
+        else if (index + 1 == argc) valid = false;
+        else
+        {
+            std::string_view value = argv[++index];
+            if (option == "--mode")
+            {
+                serial = value == "serial";
+                staged = value == "staged";
+                valid = serial or staged or value == "parallel";
+            }
+            else if (option == "--workers")
+                valid = parse_field(value, numWorkers) and numWorkers > 0;
+            else if (option == "--seed")
+                valid = useSeed = parse_field(value, seed);
+            else if (option == "--iterations")
+                valid = parse_iterations(value, maxIteration);
+            else if (option == "--schedule") schedule = value;
+            else if (option == "--initial") initialCondition = value;
+            else if (option == "--time")
+                valid = parse_field(value, timeBudget) and timeBudget >= 0;
+            else if (option == "--problem") problemPath = value;
+            else if (option == "--generate") generatorSpec = value;
+            else if (option == "--out") outputRoot = value;
+            else if (option == "--sweep") sweepSpec = value;
+            else valid = false;
+        }
+
+        if (!valid)
+        {
+            std::cerr << "Bad option or value at '" << option << "'.\n";
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!is_schedule(schedule))
+    {
+        std::cerr << "Unknown disorder schedule '" << schedule << "'.\n";
+        return 1;
+    }
+    if (initialCondition != "bucket" and initialCondition != "curve" and
+        initialCondition != "partition" and initialCondition != "random")
+    {
+        std::cerr << "Unknown initial condition '" << initialCondition
+                  << "'.\n";
+        return 1;
+    }
+
+    /* Sweep? Runs default to the configuration above. */
+    SweepSpec sweep;
+    sweep.modes = {staged ? "staged" : serial ? "serial" : "parallel"};
+    sweep.workers = {numWorkers};
+    sweep.synchronous = {fullySynchronous};
+    sweep.seeds = {useSeed ? seed : kSeedSkip};
+    sweep.schedules = {schedule};
+    {
+        std::stringstream errors;
+        if (!parse_sweep(sweepSpec, sweep, errors))
+        {
+            std::cerr << errors.str();
+            return 1;
+        }
+    }
+
     /* Problem? */
     Problem problem;
     if (useSeed) problem.set_seed(seed);
-    problem_definition::define(problem);
+    {
+        std::stringstream errors;
+        bool defined = true;
+        if (!problemPath.empty())
+            defined = problem.load_problem(problemPath, errors, numWorkers);
+        else if (!generatorSpec.empty())
+            defined = problem.generate_problem(generatorSpec, errors,
+                                               numWorkers);
+        else problem_definition::define(problem);
+        if (!defined)
+        {
+            std::cerr << errors.str();
+            return 1;
+        }
+    }
 
     /* Directory to write to - clear it. */
     std::filesystem::path outDir = "";
     if (!mouseMode)
     {
-        decltype(outDir) outRootDir = "output";
-        outDir = outRootDir / problem.name;
+        outDir = std::filesystem::path(outputRoot) / problem.name;
         problem.define_output_path(outDir);
         problem.initialise_logging();
     }
 
     /* Write annealer properties. */
-    if (serial) problem.log("Using serial annealer.");
+    if (!sweepSpec.empty()) problem.log("Sweeping over '" + sweepSpec + "'.");
+    else if (staged)
+    {
+        std::stringstream message;
+        message << "Using staged annealer with " << numWorkers << " workers.";
+        problem.log(message.str());
+    }
+    else if (serial) problem.log("Using serial annealer.");
     else
     {
         std::stringstream message;
@@ -36,13 +276,183 @@ int main()
         message << "parallel annealer with " << numWorkers << " workers.";
         problem.log(message.str());
     }
+    if (sweepSpec.empty())
+        problem.log("Using disorder schedule '" + schedule + "'.");
 
-    /* Prepare problem for annealing */
-    problem.initialise_edge_cache(
-        static_cast<unsigned>(problem.nodeHs.size()));
-    problem.populate_edge_cache();
-    problem.initial_condition_random();
+    /* Prepare problem for annealing (binary problem files may come with the
+     * edge cache). */
+    if (!problem.has_edge_cache())
+    {
+        problem.initialise_edge_cache(
+            static_cast<unsigned>(problem.nodeHs.size()));
+        problem.populate_edge_cache();
+    }
 
+    /* Create the annealer and do the dirty. If we're not seeding, the
+     * annealer seeds itself from a random device. If we're in mouse mode, run
+     * as quietly as possible, printing timing (and collision, in parallel)
+     * information only. Otherwise, run noisily with much logging and
+     * outputting of files. Sweeps run quietly, and write only their
+     * results. */
+    bool sweeping = !sweepSpec.empty();
+    auto annealerSeed = useSeed ? seed : kSeedSkip;
+    auto annealerOutDir = sweeping ? std::filesystem::path() : outDir;
+    auto configureAnnealer = [&](auto& annealer)
+    {
+        annealer.warm_start(warmStartFraction);
+        annealer.stop_on_stagnation(stagnationWindow);
+        annealer.stop_on_low_acceptance(acceptanceThreshold, acceptanceWindow);
+        if (useTargetFitness) annealer.stop_on_target(targetFitness);
+        annealer.run_for(timeBudget);
+        if (calibrateDisorder)
+            annealer.calibrate(startAcceptance, endAcceptance);
+        annealer.retain_best(checkpointEvery);
+        annealer.reheat_on_stagnation(reheatWindow, reheatFraction,
+                                      restartFromBest);
+        annealer.snapshot_every(snapshotEvery);
+        annealer.save_resume_every(resumeEvery);
+        if (!resumePath.empty() and !sweeping)
+            annealer.resume_from(resumePath);
+    };
+
+    /* Annealers are instantiated for each disorder schedule (see
+     * serial_annealer-impl.hpp), so the schedule is chosen at runtime by
+     * type. Returns the number of iterations run. */
+    auto annealWith = [&](auto scheduleType)
+    {
+        using DisorderT = typename decltype(scheduleType)::type;
+        if (staged)
+        {
+            StagedAnnealer<DisorderT> annealer(numWorkers, maxIteration,
+                                               annealerOutDir, annealerSeed);
+            configureAnnealer(annealer);
+            annealer(problem);
+            return annealer.iterationsRun;
+        }
+        else if (serial)
+        {
+            SerialAnnealer<DisorderT> annealer(maxIteration, annealerOutDir,
+                                               annealerSeed);
+            configureAnnealer(annealer);
+            annealer(problem);
+            return annealer.iterationsRun;
+        }
+        else
+        {
+            ParallelAnnealer<DisorderT> annealer(numWorkers, maxIteration,
+                                                 annealerOutDir, annealerSeed);
+            configureAnnealer(annealer);
+            if (sweeping) annealer(problem, fullySynchronous);
+            else if (mouseMode)
+            {
+                annealer.track_footprints();
+                annealer(problem, fullySynchronous);
+                float unreliableRatio =
+                    1 - (double(annealer.reliableIterations) /
+                         annealer.iterationsRun);
+                std::cout << unreliableRatio << std::endl;
+            }
+
+            /* Take intermediate fitness measurements. */
+            else annealer(problem, maxIteration / 20, fullySynchronous);
+            return annealer.iterationsRun;
+        }
+    };
+    auto anneal = [&]()
+    {
+        if (schedule == "linear")
+            return annealWith(std::type_identity<LinearDecayDisorder>());
+        else if (schedule == "adaptive")
+            return annealWith(std::type_identity<AdaptiveDisorder>());
+        else if (schedule == "none")
+            return annealWith(std::type_identity<NoDisorder>());
+        else if (schedule == "zero")
+            return annealWith(std::type_identity<AbsoluteZero>());
+        return annealWith(std::type_identity<ExpDecayDisorder>());
+    };
+
+    auto placeInitially = [&]()
+    {
+        if (!warmStartPath.empty())
+        {
+            std::stringstream errors;
+            if (problem.initial_condition_warm(warmStartPath, errors))
+                return true;
+            std::cerr << errors.str();
+            return false;
+        }
+        else if (initialCondition == "bucket")
+            problem.initial_condition_bucket();
+        else if (initialCondition == "curve")
+            problem.initial_condition_curve();
+        else if (initialCondition == "partition")
+            problem.initial_condition_partition(numWorkers);
+        else problem.initial_condition_random();
+        return true;
+    };
+
+    /* Sweep over every combination of the sweep spec, placing the problem
+     * afresh before each run (seeded by the run's seed), and reusing
+     * everything else. Serial runs ignore the worker count, and only
+     * parallel runs are synchronous or not. Results go to stdout in mouse
+     * mode. */
+    if (sweeping)
+    {
+        std::ofstream resultsFile;
+        if (!mouseMode) resultsFile.open(outDir / "sweep.csv");
+        std::ostream& results = mouseMode ? std::cout : resultsFile;
+        results << "repeat,mode,workers,synchronous,schedule,seed,"
+                << "initial_fitness,final_fitness,iterations,seconds"
+                << std::endl;
+
+        for (unsigned repeat = 0; repeat < sweep.repeats; repeat++)
+        for (const auto& runSchedule : sweep.schedules)
+        for (const auto& runSeed : sweep.seeds)
+        for (const auto& mode : sweep.modes)
+        for (const auto& workers : sweep.workers)
+        for (const bool synchronous : sweep.synchronous)
+        {
+            serial = mode == "serial";
+            staged = mode == "staged";
+            if (serial and (workers != sweep.workers.front() or
+                            synchronous != sweep.synchronous.front()))
+                continue;
+            if (staged and synchronous != sweep.synchronous.front())
+                continue;
+            numWorkers = serial ? 1 : workers;
+            fullySynchronous = !serial and !staged and synchronous;
+            schedule = runSchedule;
+            annealerSeed = runSeed;
+
+            {
+                std::stringstream message;
+                message << "Sweep run: " << mode << " with " << numWorkers
+                        << " worker(s), schedule '" << schedule << "'.";
+                problem.log(message.str());
+            }
+
+            problem.set_seed(runSeed);
+            problem.clear_locations();
+            if (!placeInitially()) return 1;
+            auto initialFitness = problem.compute_total_fitness(numWorkers);
+            auto timeAtStart = std::chrono::steady_clock::now();
+            auto iterations = anneal();
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - timeAtStart;
+
+            results << repeat << "," << mode << "," << numWorkers << ","
+                    << fullySynchronous << "," << schedule << ",";
+            if (runSeed != kSeedSkip) results << runSeed;
+            results << "," << initialFitness << ","
+                    << problem.compute_total_fitness(numWorkers) << ","
+                    << iterations << "," << elapsed.count() << std::endl;
+        }
+
+        problem.log("Sweep complete.");
+        return 0;
+    }
+
+    if (!placeInitially()) return 1;
     if (!mouseMode)
     {
         /* Check/write integrity */
@@ -72,96 +482,21 @@ int main()
         /* Begin to solve the problem. */
         {
             std::stringstream message;
-            message << "Annealing problem for " << maxIteration
-                    << " iterations.";
+            message << "Annealing problem for ";
+            if (timeBudget > 0) message << timeBudget << " seconds.";
+            else message << maxIteration << " iterations.";
             problem.log(message.str());
         }
     }
 
-    /* Create the annealer and do the dirty. */
-    if (!mouseMode)
-    {
-        /* Run noisily with much logging and outputting of files. */
-        if (serial)
-        {
-            if (useSeed)
-            {
-                SerialAnnealer<ExpDecayDisorder>
-                    (maxIteration, outDir, seed)(problem);
-            }
-            else
-            {
-                SerialAnnealer<ExpDecayDisorder>
-                    (maxIteration, outDir)(problem);
-            }
-        }
-        else
-        {
-            /* Take intermediate fitness measurements. */
-            if (useSeed)
-            {
-                ParallelAnnealer<ExpDecayDisorder>(numWorkers, maxIteration,
-                                                   outDir, seed)
-                    (problem, maxIteration / 20, fullySynchronous);
-            }
-            else
-            {
-                ParallelAnnealer<ExpDecayDisorder>(numWorkers, maxIteration,
-                                                   outDir)
-                    (problem, maxIteration / 20, fullySynchronous);
-            }
-        }
-    }
+    auto timeAtStart = std::chrono::steady_clock::now();
+    anneal();
 
-    else
+    if (mouseMode and (staged or serial))
     {
-        /* Run as quietly as possible, printing timing (and collision, in
-         * parallel) information only. */
-        if (serial)
-        {
-            if (useSeed)
-            {
-                auto annealer = SerialAnnealer<ExpDecayDisorder>(
-                    maxIteration, "", seed);
-                auto timeAtStart = std::chrono::steady_clock::now();
-                annealer(problem);
-                std::cout << std::chrono::duration_cast<std::chrono::seconds>(
-                    std::chrono::steady_clock::now() - timeAtStart).count()
-                          << std::endl;
-            }
-            else
-            {
-                auto annealer = SerialAnnealer<ExpDecayDisorder>(maxIteration);
-                auto timeAtStart = std::chrono::steady_clock::now();
-                annealer(problem);
-                std::cout << std::chrono::duration_cast<std::chrono::seconds>(
-                    std::chrono::steady_clock::now() - timeAtStart).count()
-                          << std::endl;
-            }
-        }
-        else
-        {
-            if (useSeed)
-            {
-                auto annealer = ParallelAnnealer<ExpDecayDisorder>(
-                    numWorkers, maxIteration, "", seed);
-                annealer(problem, fullySynchronous);
-		float unreliableRatio =
-		    1 - (double(annealer.reliableIterations) /
-			 maxIteration);
-                std::cout << unreliableRatio << std::endl;
-            }
-            else
-            {
-                auto annealer = ParallelAnnealer<ExpDecayDisorder>(
-                    numWorkers, maxIteration);
-                annealer(problem, fullySynchronous);
-		float unreliableRatio =
-		    1 - (double(annealer.reliableIterations) /
-			 maxIteration);
-                std::cout << unreliableRatio << std::endl;
-            }
-        }
+        std::cout << std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now() - timeAtStart).count()
+                  << std::endl;
     }
 
     /* Write solved stuff */
@@ -1,10 +1,13 @@
 #include "parallel_annealer.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <mutex>
 #include <sstream>
 #include <thread>
 #include <utility>
+#include <vector>
 
 template<class DisorderT>
 ParallelAnnealer<DisorderT>::ParallelAnnealer(
@@ -34,6 +37,11 @@ void ParallelAnnealer<DisorderT>::anneal(Problem& problem,
                                          Iteration recordEvery,
                                          bool fullySynchronous)
 {
+    /* Scale disorder to the problem, if we've been asked to (unless
+     * resuming, in which case the schedule is restored instead). */
+    if (this->calibrationSamples > 0 and !this->resuming())
+        this->calibrate_disorder(problem);
+
     /* Set up logging.
      *
      * If no output directory has been defined, then we run without
@@ -91,20 +99,79 @@ void ParallelAnnealer<DisorderT>::anneal(Problem& problem,
         write_metadata();
     }
 
-    /* If we're doing periodic fitness updates, throw one in before starting to
-     * anneal. An expansive scope matters here. */
-    float clusteringFitness;
-    float localityFitness;
+    /* Begin where we're told to. */
+    iteration = this->firstIteration;
+
+    /* Convergence tracking, for stopping early (one per worker, persisting
+     * between recording sessions). */
+    typedef typename Annealer<DisorderT>::StopReason StopReason;
+    std::vector<typename Annealer<DisorderT>::Convergence>
+        convergences(numThreads);
+    stopping = false;
+    convergedWorkers = 0;
+    stopReason = StopReason::none;
+
+    /* Views of the shared fitness (likewise). */
+    std::vector<WorkerView> views(numThreads);
+
+    /* There is no iteration to stop at when running on a time budget. The
+     * budget includes time spent recording fitness. */
+    auto endIteration = this->end_iteration();
+    this->budgetStart = std::chrono::steady_clock::now();
+
+    /* Workers start from the true fitness (which the stopping criteria
+     * depend on). If we're doing periodic fitness updates, throw one in before
+     * starting to anneal. An expansive scope matters here. Fitness is in
+     * exact units (see Problem::compute_total_clustering_fitness_exact). */
+    auto clusteringFitness = problem.compute_total_clustering_fitness_exact();
+    auto localityFitness =
+        problem.compute_total_locality_fitness_exact(numThreads);
+
+    /* Best-state retention. Checkpoints happen while the workers are joined,
+     * so retention breaks the anneal up into segments like recording does. */
+    this->begin_retention(problem, iteration);
+
+    /* Resume from a saved state, if we've been asked to, with the fitness
+     * the workers had shared. Saves happen while the workers are joined,
+     * too. */
+    Iteration resumedIteration = iteration;
+    if (this->load_resume(problem, resumedIteration, clusteringFitness,
+                          localityFitness, convergences))
+    {
+        iteration = resumedIteration;
+
+        /* Workers that had voted to stop keep their votes. If every worker
+         * had (only possible with fewer workers than were saved), they vote
+         * again. */
+        for (const auto& convergence : convergences)
+            if (convergence.voted) convergedWorkers++;
+        if (convergedWorkers == numThreads)
+        {
+            for (auto& convergence : convergences) convergence.voted = false;
+            convergedWorkers = 0;
+        }
+    }
+    Iteration nextSave = iteration + this->resumeEvery;
+
     if (this->log and recordEvery != 0)
     {
-        clusteringFitness = problem.compute_total_clustering_fitness();
-        localityFitness = problem.compute_total_locality_fitness();
         csvOutMaster << iteration << ","
-                     << clusteringFitness + localityFitness << ","
-                     << clusteringFitness << ","
-                     << localityFitness << std::endl;
+                     << Problem::to_fitness(clusteringFitness +
+                                            localityFitness) << ","
+                     << Problem::to_fitness(clusteringFitness) << ","
+                     << Problem::to_fitness(localityFitness) << std::endl;
     }
 
+    /* The hot loop, compiled for the policies in effect. */
+    unsigned degree = this->log ? 0 : this->begin_fixed_degree(problem);
+    CoAnneal coAnneal;
+    if (fullySynchronous) coAnneal = choose_co_anneal<Synchronous>(degree);
+    else coAnneal = choose_co_anneal<SemiAsynchronous>(degree);
+
+    /* Background snapshots of the placement, stamped with the shared
+     * iteration. */
+    this->begin_snapshots(problem, iteration);
+
     /* Initialise timer in a stupid way. */
     auto now = std::chrono::steady_clock::now();
     auto wallClock = now - now;  /* Zero */
@@ -122,36 +189,42 @@ void ParallelAnnealer<DisorderT>::anneal(Problem& problem,
         Iteration nextStop;
         if (recordEvery == 0 or (this->log == false))
         {
-            nextStop = this->maxIteration;
+            nextStop = endIteration;
         }
-        else nextStop = std::min(this->maxIteration, iteration + recordEvery);
+        else nextStop = std::min(endIteration, iteration + recordEvery);
+        if (this->checkpointEvery > 0)
+        {
+            nextStop = std::min(nextStop,
+                                iteration + this->checkpointEvery);
+        }
+        if (this->resumeEvery > 0) nextStop = std::min(nextStop, nextSave);
 
         /* Measure wallclock time between now and when the threads are joined
          * with. */
         auto timeAtStart = std::chrono::steady_clock::now();
 
-        /* Spawn slave threads to do the annealing. */
+        /* Spawn slave threads to do the annealing, sharing the true
+         * fitness. */
+        sharedClusteringFitness = clusteringFitness;
+        sharedLocalityFitness = localityFitness;
         std::vector<std::thread> threads;
         for (unsigned threadId = 0; threadId < numThreads; threadId++)
         {
-            if (fullySynchronous)
-            {
-                threads.emplace_back(
-                    &ParallelAnnealer<DisorderT>::co_anneal_synchronous,
-                    this, std::ref(problem), std::ref(csvOuts.at(threadId)),
-                    nextStop, clusteringFitness, localityFitness);
-            }
-            else
-            {
-                threads.emplace_back
-                    (&ParallelAnnealer<DisorderT>::co_anneal_sasynchronous,
-                     this, std::ref(problem), std::ref(csvOuts.at(threadId)),
-                     nextStop, clusteringFitness, localityFitness);
-            }
+            threads.emplace_back(
+                coAnneal, this, std::ref(problem),
+                std::ref(csvOuts.at(threadId)), nextStop, clusteringFitness,
+                localityFitness, std::ref(convergences.at(threadId)),
+                std::ref(views.at(threadId)));
         }
 
-        /* Join with slave threads. */
+        /* Join with slave threads. Workers fold in after every chunk, so the
+         * shared fitness is complete. Carry it over (it is refreshed below if
+         * we compute the true fitness). Workers claim chunks past nextStop
+         * as they finish, but don't run them. */
         for (auto& thread : threads) thread.join();
+        if (iteration > nextStop) iteration = nextStop;
+        clusteringFitness = sharedClusteringFitness;
+        localityFitness = sharedLocalityFitness;
 
         /* The other end of the wallclock measurement. */
         wallClock += (std::chrono::steady_clock::now() - timeAtStart);
@@ -165,19 +238,80 @@ void ParallelAnnealer<DisorderT>::anneal(Problem& problem,
                     << iteration << "...";
             problem.log(message.str());
 
-            /* Fitness computation and logging. */
-            clusteringFitness = problem.compute_total_clustering_fitness();
-            localityFitness = problem.compute_total_locality_fitness();
+            /* Fitness computation and logging, noting how far the shared
+             * fitness had drifted from it. */
+            auto sharedFitness = clusteringFitness + localityFitness;
+            clusteringFitness =
+                problem.compute_total_clustering_fitness_exact();
+            localityFitness =
+                problem.compute_total_locality_fitness_exact(numThreads);
+            message.str("");
+            message << "Shared fitness had drifted by "
+                    << Problem::to_fitness(sharedFitness - clusteringFitness -
+                                           localityFitness)
+                    << " from the true fitness.";
+            problem.log(message.str());
             csvOutMaster << iteration << ","
-                         << clusteringFitness + localityFitness << ","
-                         << clusteringFitness << ","
-                         << localityFitness << std::endl;
+                         << Problem::to_fitness(clusteringFitness +
+                                                localityFitness) << ","
+                         << Problem::to_fitness(clusteringFitness) << ","
+                         << Problem::to_fitness(localityFitness) << std::endl;
 
             /* End timestamp */
             problem.log("Fitness logged.");
         }
+
+        /* Retention, from the true fitness (which workers restart from
+         * too). */
+        if (this->checkpointEvery > 0 and !stopping)
+        {
+            Iteration schedulePosition = iteration;
+            if (this->timeBudget > 0)
+            {
+                Iteration clockCountdown = 0;
+                this->advance_schedule(clockCountdown, schedulePosition, 0);
+            }
+            clusteringFitness =
+                problem.compute_total_clustering_fitness_exact();
+            localityFitness =
+                problem.compute_total_locality_fitness_exact(numThreads);
+            if (this->checkpoint(
+                    problem,
+                    Problem::to_fitness(clusteringFitness + localityFitness),
+                    iteration, schedulePosition))
+            {
+                clusteringFitness =
+                    problem.compute_total_clustering_fitness_exact();
+                localityFitness =
+                    problem.compute_total_locality_fitness_exact(numThreads);
+            }
+        }
+
+        /* Saving, for resuming later. */
+        if (this->resumeEvery > 0 and !stopping and iteration >= nextSave and
+            iteration < endIteration)
+        {
+            this->save_resume(problem, iteration, clusteringFitness,
+                              localityFitness, convergences);
+            nextSave = iteration + this->resumeEvery;
+        }
+    }
+    while (iteration < endIteration and !stopping);
+
+    /* Unrun claims are dropped as workers are joined (see above). */
+    this->iterationsRun = std::min(Iteration(iteration), endIteration) -
+        this->firstIteration;
+    if (stopping)
+    {
+        std::stringstream message;
+        message << "Stopped at iteration " << iteration << " ("
+                << this->describe(stopReason) << ").";
+        problem.log(message.str());
     }
-    while (iteration < this->maxIteration);
+    log_worker_views(problem, views);
+    problem.clear_fixed_degree_view();
+    this->end_retention(problem);
+    this->end_snapshots();
 
     /* Write wallclock information and close log files. */
     if (this->log)
@@ -191,254 +325,289 @@ void ParallelAnnealer<DisorderT>::anneal(Problem& problem,
 }
 
 /* An individual hammer, to be wielded by a single thread. Communicates with
- * other threads semi-asynchronously. */
+ * other threads synchronously or semi-asynchronously, depending on SyncT,
+ * logs, tracks footprints and checks convergence depending on LogT,
+ * FootprintT and ConvergenceT, and computes locality fitness according to
+ * DegreeT (see annealer_policies.hpp).
+ *
+ * Workers claim chunks of fitnessFoldEvery iterations from the shared
+ * iteration, and fold their fitness in after each. Stopping and the time
+ * budget are checked between chunks, so each claimed chunk is run in full
+ * (up to maxIteration), and a worker that has voted to stop carries on to the
+ * end of its chunk. */
 template<class DisorderT>
-void ParallelAnnealer<DisorderT>::co_anneal_sasynchronous(
+template<class LogT, class SyncT, class FootprintT, class ConvergenceT,
+         class DegreeT>
+void ParallelAnnealer<DisorderT>::co_anneal(
     Problem& problem, std::ofstream& csvOut, Iteration maxIteration,
-    float oldClusteringFitness, float oldLocalityFitness)
+    ExactFitness oldClusteringFitness, ExactFitness oldLocalityFitness,
+    typename Annealer<DisorderT>::Convergence& convergence, WorkerView& view)
 {
     auto selA = problem.nodeAs.begin();
     auto selH = problem.nodeHs.begin();
     auto oldH = problem.nodeHs.begin();
 
-    /* Base fitness "used" from the start of each iteration. Note that the
-     * currently-stored fitness will drift from the total fitness. This is fine
-     * because determination only care about the fitness difference from an
-     * operation - not its absolute value or ratio. */
+    /* Base fitness "used" from the start of each iteration, in exact units.
+     * Note that the currently-stored fitness will drift from the total
+     * fitness, because it doesn't see the moves of other threads (though
+     * not through rounding). This is fine because determination only care
+     * about the fitness difference from an operation - not its absolute value
+     * or ratio. */
     auto oldFitness = oldClusteringFitness + oldLocalityFitness;
 
     /* Really, nobody cares about the initial fitness value, but it's
      * interesting to watch it change. */
-    if (this->log) csvOut << "-1,-1,-1,0,"
-                          << oldFitness << ","
-                          << oldClusteringFitness << ","
-                          << oldLocalityFitness << ",1,1\n";
-
-    Iteration localIteration;
-    do
+    if constexpr (LogT::enabled)
+        csvOut << "-1,-1,-1,0,"
+               << Problem::to_fitness(oldFitness) << ","
+               << Problem::to_fitness(oldClusteringFitness) << ","
+               << Problem::to_fitness(oldLocalityFitness) << ",1,1\n";
+
+    /* Position in the disorder schedule (see SerialAnnealer::anneal_with). */
+    Iteration scheduleIteration = this->timeBudget > 0 ? iteration.load() : 0;
+    Iteration scheduleStride = this->timeBudget > 0 ? 0 : 1;
+    Iteration clockCountdown = 0;
+
+    while (!stopping.load(std::memory_order_relaxed))  /* Termination */
     {
-        /* Get the iteration number. The variable "iteration" is shared between
-         * threads. */
-        localIteration = iteration++;
-        if (this->log) csvOut << localIteration << ",";
-
-        /* "Atomic" selection */
-        auto selectionCollisions = \
-            problem.select_parallel_sasynchronous(selA, selH, oldH);
-        if (this->log) csvOut << selA - problem.nodeAs.begin() << ","
-                              << selH - problem.nodeHs.begin() << ","
-                              << selectionCollisions << ",";
-
-        /* RAII locking */
-        std::lock_guard<decltype((*selA)->lock)> appLock((*selA)->lock,
-                                                         std::adopt_lock);
-
-        /* Compute the transformation footprint, so that we can identify
-         * whether or not the fitness computation is reliable (it is unreliable
-         * if another thread changes a relevant bit of the datastructure. We
-         * don't do anything different if it is unreliable outside of
-         * logging the occurence in the output). */
-        TransformCount oldTformFootprint = compute_transform_footprint(
-            selA, selH, oldH);
-
-        /* Fitness of components before transformation. */
-        auto oldClusteringFitnessComponents =
-            problem.compute_hw_node_clustering_fitness(**selH) +
-            problem.compute_hw_node_clustering_fitness(**oldH);
-
-        auto oldLocalityFitnessComponents =
-            problem.compute_app_node_locality_fitness(**selA) * 2;
-
-        /* Transformation */
-        locking_transform(problem, selA, selH, oldH);
-
-        /* Fitness of components after transformation. */
-        auto newClusteringFitnessComponents =
-            problem.compute_hw_node_clustering_fitness(**selH) +
-            problem.compute_hw_node_clustering_fitness(**oldH);
-
-        auto newLocalityFitnessComponents =
-            problem.compute_app_node_locality_fitness(**selA) * 2;
-
-        /* Footprint after transformation. Note the minus three - this is
-         * because our move transformation causes three changes to the data
-         * structure, and we don't want to count those. */
-        TransformCount newTformFootprint = compute_transform_footprint(
-            selA, selH, oldH) - 3;
-
-        /* New fitness computation. */
-        auto newClusteringFitness = oldClusteringFitness -
-            oldClusteringFitnessComponents + newClusteringFitnessComponents;
-
-        auto newLocalityFitness = oldLocalityFitness -
-            oldLocalityFitnessComponents + newLocalityFitnessComponents;
-
-        auto newFitness = newLocalityFitness + newClusteringFitness;
-
-        /* Writing new fitness value to CSV, and whether or not the fitness
-         * computation this iteration is unreliable. */
-        if (this->log) csvOut << newFitness << ","
-                              << newClusteringFitness << ","
-                              << newLocalityFitness << ","
-                              << (oldTformFootprint == newTformFootprint)
-                              << ",";
-
-	/* Track reliable fitness computation. */
-        if (oldTformFootprint == newTformFootprint) reliableIterations++;
-
-        /* Determination */
-        bool sufficientlyDetermined =
-            this->disorder.determine(oldFitness, newFitness, localIteration);
-
-        /* If the solution was sufficiently determined to be chosen, update the
-         * base fitness to support computation for the next
-         * iteration. Otherwise, revert the solution. */
-        if (sufficientlyDetermined)
+        if (this->timeBudget > 0 and
+            !this->advance_schedule(clockCountdown, scheduleIteration,
+                                    fitnessFoldEvery))
         {
-            if (this->log) csvOut << 1 << '\n';
-            oldFitness = newFitness;
-            oldClusteringFitness = newClusteringFitness;
-            oldLocalityFitness = newLocalityFitness;
+            vote_to_stop(convergence,
+                         Annealer<DisorderT>::StopReason::budgetSpent);
+            break;
         }
 
-        else
-        {
-            if (this->log) csvOut << 0 << '\n';
-            locking_transform(problem, selA, oldH, selH);
-        }
-    }
-    while (iteration < maxIteration);  /* Termination condition */
-}
-
-/* An individual hammer, to be wielded by a single thread. Communicates with
- * other threads synchronously.
- *
- * Shameless code duplication with the semi-asynchronous co-anneal method, but
- * life is short. */
-template<class DisorderT>
-void ParallelAnnealer<DisorderT>::co_anneal_synchronous(
-    Problem& problem, std::ofstream& csvOut, Iteration maxIteration,
-    float oldClusteringFitness, float oldLocalityFitness)
-{
-    auto selA = problem.nodeAs.begin();
-    auto selH = problem.nodeHs.begin();
-    auto oldH = problem.nodeHs.begin();
-
-    /* Base fitness "used" from the start of each iteration. Note that the
-     * currently-stored fitness will drift from the total fitness. This is fine
-     * because determination only care about the fitness difference from an
-     * operation - not its absolute value or ratio. */
-    auto oldFitness = oldClusteringFitness + oldLocalityFitness;
-
-    /* Really, nobody cares about the initial fitness value, but it's
-     * interesting to watch it change. */
-    if (this->log) csvOut << "-1,-1,-1,0,"
-                          << oldFitness << ","
-                          << oldClusteringFitness << ","
-                          << oldLocalityFitness << ",1,1\n";
-
-    Iteration localIteration;
-    do
-    {
-        /* Get the iteration number. The variable "iteration" is shared between
-         * threads. */
-        localIteration = iteration++;
-        if (this->log) csvOut << localIteration << ",";
-
-        /* "Atomic" selection */
-        auto selectionCollisions = \
-            problem.select_parallel_synchronous(selA, selH, oldH);
-        if (this->log) csvOut << selA - problem.nodeAs.begin() << ","
-                              << selH - problem.nodeHs.begin() << ","
-                              << selectionCollisions << ",";
-
-        /* RAII locking - selected application node, selected hardware node,
-         * old hardware node, and neighbouring application nodes. We're just
-         * adopting the previously-locked nodes here. */
-        std::vector<std::unique_lock<decltype((*selA)->lock)>> appLocks;
-        appLocks.emplace_back((*selA)->lock, std::adopt_lock);
-        appLocks.emplace_back((*selH)->lock, std::adopt_lock);
-        appLocks.emplace_back((*oldH)->lock, std::adopt_lock);
-        for (const auto& neighbour : (*selA)->neighbours)
-            appLocks.emplace_back(neighbour.lock()->lock, std::adopt_lock);
-
-        /* Compute the transformation footprint. */
-        TransformCount oldTformFootprint = compute_transform_footprint(
-            selA, selH, oldH);
-
-        /* Fitness of components before transformation. */
-        auto oldClusteringFitnessComponents =
-            problem.compute_hw_node_clustering_fitness(**selH) +
-            problem.compute_hw_node_clustering_fitness(**oldH);
-
-        auto oldLocalityFitnessComponents =
-            problem.compute_app_node_locality_fitness(**selA) * 2;
-
-        /* Transformation. Note it's not a locking transform, because we've
-         * already claimed our locks for this iteration. */
-        problem.transform(selA, selH, oldH);
-
-        /* Increment transformation counters, to be sporting. */
-        (*selA)->transformCount++;
-        (*selH)->transformCount++;
-        (*oldH)->transformCount++;
+        /* Claim a chunk of iterations. The variable "iteration" is shared
+         * between threads. */
+        Iteration chunkStart = iteration.fetch_add(fitnessFoldEvery,
+                                                   std::memory_order_relaxed);
+        if (chunkStart >= maxIteration) break;
+        auto chunkEnd = std::min(chunkStart + fitnessFoldEvery, maxIteration);
 
-        /* Fitness of components after transformation. */
-        auto newClusteringFitnessComponents =
-            problem.compute_hw_node_clustering_fitness(**selH) +
-            problem.compute_hw_node_clustering_fitness(**oldH);
+        for (auto localIteration = chunkStart; localIteration < chunkEnd;
+             localIteration++)
+        {
+            if constexpr (LogT::enabled) csvOut << localIteration << ",";
 
-        auto newLocalityFitnessComponents =
-            problem.compute_app_node_locality_fitness(**selA) * 2;
+            /* "Atomic" selection */
+            unsigned selectionCollisions;
+            if constexpr (SyncT::synchronous)
+                selectionCollisions =
+                    problem.select_parallel_synchronous(selA, selH, oldH);
+            else
+                selectionCollisions =
+                    problem.select_parallel_sasynchronous(selA, selH, oldH);
+            if constexpr (LogT::enabled)
+                csvOut << selA - problem.nodeAs.begin() << ","
+                       << selH - problem.nodeHs.begin() << ","
+                       << selectionCollisions << ",";
+
+            /* RAII locking - we're just adopting the locks claimed by
+             * selection here. That's the selected application node and, if
+             * synchronous, the selected hardware node, old hardware node, and
+             * neighbouring application nodes. */
+            std::unique_lock<decltype((*selA)->lock)> appLock(
+                (*selA)->lock, std::adopt_lock);
+            std::vector<std::unique_lock<decltype((*selA)->lock)>> otherLocks;
+            if constexpr (SyncT::synchronous)
+            {
+                otherLocks.emplace_back((*selH)->lock, std::adopt_lock);
+                otherLocks.emplace_back((*oldH)->lock, std::adopt_lock);
+                for (const auto& neighbour : (*selA)->neighbours)
+                    otherLocks.emplace_back(neighbour.lock()->lock,
+                                            std::adopt_lock);
+            }
 
-        /* Footprint after transformation. Note the minus three - this is
-         * because our move transformation causes three changes to the data
-         * structure, and we don't want to count those. */
-        TransformCount newTformFootprint = compute_transform_footprint(
-            selA, selH, oldH) - 3;
+            /* Compute the transformation footprint, so that we can identify
+             * whether or not the fitness computation is reliable (it is
+             * unreliable if another thread changes a relevant bit of the
+             * datastructure. We don't do anything different if it is
+             * unreliable outside of logging the occurence in the output). */
+            TransformCount oldTformFootprint = 0;
+            if constexpr (FootprintT::enabled)
+                oldTformFootprint =
+                    compute_transform_footprint(selA, selH, oldH);
+
+            /* Fitness of components before transformation. */
+            auto oldClusteringFitnessComponents =
+                problem.compute_hw_node_clustering_fitness_exact(**selH) +
+                problem.compute_hw_node_clustering_fitness_exact(**oldH);
+
+            auto oldLocalityFitnessComponents =
+                problem.compute_app_node_locality_fitness_exact<
+                    DegreeT::maxDegree>(selA) * 2;
+
+            /* Transformation */
+            policy_transform<SyncT, FootprintT, DegreeT::maxDegree != 0,
+                             LogT::enabled>(problem, selA, selH, oldH);
+
+            /* Fitness of components after transformation. */
+            auto newClusteringFitnessComponents =
+                problem.compute_hw_node_clustering_fitness_exact(**selH) +
+                problem.compute_hw_node_clustering_fitness_exact(**oldH);
+
+            auto newLocalityFitnessComponents =
+                problem.compute_app_node_locality_fitness_exact<
+                    DegreeT::maxDegree>(selA) * 2;
+
+            /* Footprint after transformation. Note the minus three - this
+             * is because our move transformation causes three changes to the
+             * data structure, and we don't want to count those. */
+            bool reliable = true;
+            if constexpr (FootprintT::enabled)
+            {
+                reliable = oldTformFootprint ==
+                    compute_transform_footprint(selA, selH, oldH) - 3;
+                if (reliable) reliableIterations++;
+            }
 
-        /* New fitness computation. */
-        auto newClusteringFitness = oldClusteringFitness -
-            oldClusteringFitnessComponents + newClusteringFitnessComponents;
+            /* New fitness computation. */
+            auto newClusteringFitness = oldClusteringFitness -
+                oldClusteringFitnessComponents +
+                newClusteringFitnessComponents;
+
+            auto newLocalityFitness = oldLocalityFitness -
+                oldLocalityFitnessComponents + newLocalityFitnessComponents;
+
+            auto newFitness = newLocalityFitness + newClusteringFitness;
+
+            /* Writing new fitness value to CSV, and whether or not the fitness
+             * computation this iteration is unreliable. */
+            if constexpr (LogT::enabled)
+                csvOut << Problem::to_fitness(newFitness) << ","
+                       << Problem::to_fitness(newClusteringFitness) << ","
+                       << Problem::to_fitness(newLocalityFitness) << ","
+                       << reliable << ",";
+
+            /* Determination, from the exact difference in fitness (see
+             * SerialAnnealer::anneal_with). */
+            auto fitnessDifference = static_cast<float>(
+                Problem::to_fitness(newFitness - oldFitness));
+            bool sufficientlyDetermined = this->disorder.determine(
+                0, fitnessDifference, this->reheated(
+                    scheduleIteration + localIteration * scheduleStride));
+
+            /* If the solution was sufficiently determined to be chosen,
+             * update the base fitness to support computation for the next
+             * iteration. Otherwise, revert the solution. */
+            if (sufficientlyDetermined)
+            {
+                if constexpr (LogT::enabled) csvOut << 1 << '\n';
+                view.pendingClustering +=
+                    newClusteringFitness - oldClusteringFitness;
+                view.pendingLocality +=
+                    newLocalityFitness - oldLocalityFitness;
+                oldFitness = newFitness;
+                oldClusteringFitness = newClusteringFitness;
+                oldLocalityFitness = newLocalityFitness;
+            }
 
-        auto newLocalityFitness = oldLocalityFitness -
-            oldLocalityFitnessComponents + newLocalityFitnessComponents;
+            else
+            {
+                if constexpr (LogT::enabled) csvOut << 0 << '\n';
+                policy_transform<SyncT, FootprintT, DegreeT::maxDegree != 0,
+                                 LogT::enabled>(problem, selA, oldH, selH);
+            }
 
-        auto newFitness = newLocalityFitness + newClusteringFitness;
+            if constexpr (ConvergenceT::enabled)
+            {
+                auto reason = this->check_convergence(
+                    convergence, Problem::to_fitness(oldFitness),
+                    sufficientlyDetermined);
+                if (reason != Annealer<DisorderT>::StopReason::none)
+                    vote_to_stop(convergence, reason);
+            }
+        }
 
-        /* Writing new fitness value to CSV, and whether or not the fitness
-         * computation this iteration is unreliable. */
-        if (this->log) csvOut << newFitness << ","
-                              << newClusteringFitness << ","
-                              << newLocalityFitness << ","
-                              << (oldTformFootprint == newTformFootprint)
-                              << ",";
+        /* Catch up with the other workers. */
+        fold_fitness(view, oldClusteringFitness, oldLocalityFitness);
+        oldFitness = oldClusteringFitness + oldLocalityFitness;
+    }
+}
 
-        /* Track reliable fitness computation. */
-        if (oldTformFootprint == newTformFootprint) reliableIterations++;
+/* Folds a worker's accepted changes into the shared fitness, and updates the
+ * worker's view of the fitness (`clusteringFitness` and `localityFitness`) to
+ * the result. Records how far the worker's view had deviated, which is the
+ * sum of the changes accepted by other workers since it last folded. */
+template<class DisorderT>
+void ParallelAnnealer<DisorderT>::fold_fitness(WorkerView& view,
+                                               ExactFitness& clusteringFitness,
+                                               ExactFitness& localityFitness)
+{
+    auto sharedClustering = sharedClusteringFitness.fetch_add(
+        view.pendingClustering, std::memory_order_relaxed) +
+        view.pendingClustering;
+    auto sharedLocality = sharedLocalityFitness.fetch_add(
+        view.pendingLocality, std::memory_order_relaxed) +
+        view.pendingLocality;
+    view.pendingClustering = 0;
+    view.pendingLocality = 0;
+
+    auto deviation = std::abs(Problem::to_fitness(
+        (sharedClustering + sharedLocality) -
+        (clusteringFitness + localityFitness)));
+    view.deviationTotal += deviation;
+    view.deviationMax = std::max(view.deviationMax, deviation);
+    view.folds++;
+
+    clusteringFitness = sharedClustering;
+    localityFitness = sharedLocality;
+}
 
-        /* Determination */
-        bool sufficientlyDetermined =
-            this->disorder.determine(oldFitness, newFitness, localIteration);
+/* Logs how far each worker's view of the fitness deviated from the shared
+ * fitness between folds. */
+template<class DisorderT>
+void ParallelAnnealer<DisorderT>::log_worker_views(
+    Problem& problem, const std::vector<WorkerView>& views)
+{
+    for (decltype(views.size()) worker = 0; worker < views.size(); worker++)
+    {
+        const auto& view = views[worker];
+        if (view.folds == 0) continue;
+        std::stringstream message;
+        message << "Worker " << worker << " fitness view deviated by "
+                << view.deviationTotal / static_cast<double>(view.folds)
+                << " on average (at most " << view.deviationMax
+                << ") over " << view.folds << " fold(s).";
+        problem.log(message.str());
+    }
+}
 
-        /* If the solution was sufficiently determined to be chosen, update the
-         * base fitness to support computation for the next
-         * iteration. Otherwise, revert the solution. */
-        if (sufficientlyDetermined)
-        {
-            if (this->log) csvOut << 1 << '\n';
-            oldFitness = newFitness;
-            oldClusteringFitness = newClusteringFitness;
-            oldLocalityFitness = newLocalityFitness;
-        }
+/* Chooses the hot loop for the policies in effect, given the width of the
+ * problem's fixed-degree view (zero if there is none). Logging implies
+ * footprint tracking, because the operations CSV records reliability, and
+ * doesn't bother with the fixed-degree view. */
+template<class DisorderT>
+template<class SyncT>
+typename ParallelAnnealer<DisorderT>::CoAnneal
+    ParallelAnnealer<DisorderT>::choose_co_anneal(unsigned degree)
+{
+    if (this->log) return &ParallelAnnealer::co_anneal<
+        LogToCsv, SyncT, TrackFootprints, CheckConvergence, AnyDegree>;
+    if (trackFootprints)
+        return choose_degree<SyncT, TrackFootprints, CheckConvergence>(
+            degree);
+    if (this->checks_convergence())
+        return choose_degree<SyncT, NoFootprints, CheckConvergence>(degree);
+    return choose_degree<SyncT, NoFootprints, NoConvergence>(degree);
+}
 
-        else
-        {
-            if (this->log) csvOut << 0 << '\n';
-            problem.transform(selA, oldH, selH);
-        }
+template<class DisorderT>
+template<class SyncT, class FootprintT, class ConvergenceT>
+typename ParallelAnnealer<DisorderT>::CoAnneal
+    ParallelAnnealer<DisorderT>::choose_degree(unsigned degree)
+{
+    switch (degree)
+    {
+    case 2: return &ParallelAnnealer::co_anneal<
+        NoLogging, SyncT, FootprintT, ConvergenceT, FixedDegree<2>>;
+    case 4: return &ParallelAnnealer::co_anneal<
+        NoLogging, SyncT, FootprintT, ConvergenceT, FixedDegree<4>>;
+    default: return &ParallelAnnealer::co_anneal<
+        NoLogging, SyncT, FootprintT, ConvergenceT, AnyDegree>;
     }
-    while (iteration < maxIteration);  /* Termination condition */
 }
 
 /* Computes the transformation footprint from the set of nodes that are used
@@ -473,32 +642,88 @@ TransformCount ParallelAnnealer<DisorderT>::compute_transform_footprint(
 
 /* Performs a transform that simultaneously locks hardware nodes during the
  * transformation to avoid data races. This is a wrapper around
- * problem.transform. */
+ * problem.transform, for use while the problem has no fixed-degree view
+ * (i.e. outside the hot loop). */
 template<class DisorderT>
 void ParallelAnnealer<DisorderT>::locking_transform(Problem& problem,
     decltype(Problem::nodeAs)::iterator& selA,
     decltype(Problem::nodeHs)::iterator& selH,
     decltype(Problem::nodeHs)::iterator& oldH)
 {
-    /* Identify where the locks are (hold them as references) */
-    decltype(NodeH::lock)& selHLock = (*selH)->lock;
-    decltype(NodeH::lock)& oldHLock = (*oldH)->lock;
+    policy_transform<SemiAsynchronous, TrackFootprints>(problem, selA, selH,
+                                                        oldH);
+}
 
-    /* Lock them simultaneously. */
-    std::lock(selHLock, oldHLock);
+/* Performs a transform for the given policies. If semi-asynchronous, the
+ * hardware nodes are locked during the transformation (if synchronous,
+ * selection has locked them already). If tracking footprints, transformation
+ * counters are incremented. The view and placement are kept in step as
+ * Problem::transform_with does. */
+template<class DisorderT>
+template<class SyncT, class FootprintT, bool FixedView, bool MayPublish>
+void ParallelAnnealer<DisorderT>::policy_transform(Problem& problem,
+    decltype(Problem::nodeAs)::iterator& selA,
+    decltype(Problem::nodeHs)::iterator& selH,
+    decltype(Problem::nodeHs)::iterator& oldH)
+{
+    /* Increment transformation counters. */
+    if constexpr (FootprintT::enabled)
+    {
+        (*selA)->transformCount++;
+        (*selH)->transformCount++;
+        (*oldH)->transformCount++;
+    }
 
-    /* Unlock them together (non-simultaneously) at the end of the
-     * transformation. */
-    std::lock_guard<decltype(selHLock)> selHGuard(selHLock, std::adopt_lock);
-    std::lock_guard<decltype(oldHLock)> oldHGuard(oldHLock, std::adopt_lock);
+    if constexpr (SyncT::synchronous)
+        problem.transform_with<FixedView, MayPublish>(selA, selH, oldH);
+    else
+    {
+        /* Identify where the locks are (hold them as references) */
+        decltype(NodeH::lock)& selHLock = (*selH)->lock;
+        decltype(NodeH::lock)& oldHLock = (*oldH)->lock;
+
+        /* Lock them simultaneously. */
+        std::lock(selHLock, oldHLock);
+
+        /* Unlock them together (non-simultaneously) at the end of the
+         * transformation. */
+        std::lock_guard<decltype(selHLock)> selHGuard(selHLock,
+                                                      std::adopt_lock);
+        std::lock_guard<decltype(oldHLock)> oldHGuard(oldHLock,
+                                                      std::adopt_lock);
+
+        /* Perform the transformation. */
+        problem.transform_with<FixedView, MayPublish>(selA, selH, oldH);
+    }
+}
 
-    /* Increment transformation counters. */
-    (*selA)->transformCount++;
-    (*selH)->transformCount++;
-    (*oldH)->transformCount++;
+/* Maintains transformation counters and counts reliable fitness computations
+ * (see reliableIterations) even when not logging. Off by default, because it
+ * costs time in the hot loop. */
+template<class DisorderT>
+void ParallelAnnealer<DisorderT>::track_footprints(bool track)
+{
+    trackFootprints = track;
+}
 
-    /* Perform the transformation. */
-    problem.transform(selA, selH, oldH);
+/* Records that a worker has converged for a given reason. The anneal stops
+ * once every worker has converged, except when the target fitness is reached
+ * or the time budget is spent, which stops the anneal immediately. Each worker
+ * votes at most once. */
+template<class DisorderT>
+void ParallelAnnealer<DisorderT>::vote_to_stop(
+    typename Annealer<DisorderT>::Convergence& convergence,
+    typename Annealer<DisorderT>::StopReason reason)
+{
+    if (reason != Annealer<DisorderT>::StopReason::target and
+        reason != Annealer<DisorderT>::StopReason::budgetSpent)
+    {
+        if (convergence.voted) return;
+        convergence.voted = true;
+        if (++convergedWorkers < numThreads) return;
+    }
+    stopReason = reason;
+    stopping = true;
 }
 
 /* Uses the annealer to write metadata, then appends the number of threads to
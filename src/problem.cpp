@@ -1,7 +1,14 @@
 #include "problem.hpp"
 
+#include "binary_io.hpp"
+
 #include <algorithm>
-#include <list>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
 
 Problem::Problem()
 {
@@ -25,10 +32,16 @@ void Problem::set_seed(Seed seed)
     rng = Prng(determine_seed(seed));
 }
 
+/* Saves and loads the state of the generator, so that an anneal can be
+ * resumed exactly (see Annealer::resume_from). */
+void Problem::save_rng(std::ostream& out){write_binary(out, rng);}
+bool Problem::load_rng(std::istream& in){return read_binary(in, rng);}
+
 /* Reserve space in the edge cache as a function of the diameter, and define
  * default values as per the specification - zeroes on the diagonals, and a
  * huge number everywhere else. Also reads edgeHs to populate entries that
- * have edges. */
+ * have edges. The application graph must be defined first (see
+ * quantise_edge_cache). */
 void Problem::initialise_edge_cache(unsigned diameter)
 {
     decltype(edgeCacheH)::size_type eOuterIndex;
@@ -48,12 +61,16 @@ void Problem::initialise_edge_cache(unsigned diameter)
                 edgeCacheH[eOuterIndex][eInnerIndex] = 0;
     }
 
-    /* Populate edges. */
+    /* Populate edges, except those of hardware nodes out of service (as
+     * update_edge_cache_without would leave them). */
     for (auto edge : edgeHs)
     {
+        if (!nodeHs[std::get<0>(edge)]->available or
+            !nodeHs[std::get<1>(edge)]->available) continue;
         edgeCacheH[std::get<0>(edge)][std::get<1>(edge)] = std::get<2>(edge);
         edgeCacheH[std::get<1>(edge)][std::get<0>(edge)] = std::get<2>(edge);
     }
+    quantise_edge_cache();
 
     log("Hardware edge cache initialised.");
 }
@@ -72,14 +89,105 @@ void Problem::populate_edge_cache()
                 auto trialPathWeight = edgeCacheH[i][k] + edgeCacheH[k][j];
                 edgeCacheH[i][j] = std::min(edgeCacheH[i][j], trialPathWeight);
             }
+    quantise_edge_cache();
     log("Edge cache fully populated.");
 }
 
+/* Rebuilds the exact edge cache from the edge cache, rounding each distance
+ * to the nearest multiple of 1 / fitnessScale. Exact fitness is exact with
+ * respect to these quantised distances, which differ from the true distances
+ * by at most half a unit.
+ *
+ * Distances are capped at exactDistanceCap, which is small enough that
+ * locality fitness summed over every application edge can't overflow, with
+ * room to spare for fitness deltas and for edges added later (see
+ * add_app_edge). Infinite distances (e.g. across a hardware graph that
+ * disable_h_node has disconnected) are capped likewise. The cap depends on
+ * the application graph, so the application graph must be defined first. */
+void Problem::quantise_edge_cache()
+{
+    std::uint64_t directedEdges = 0;
+    for (const auto& nodeA : nodeAs) directedEdges += nodeA->neighbours.size();
+    exactDistanceCap = std::numeric_limits<ExactFitness>::max() /
+        static_cast<ExactFitness>(4 * (directedEdges + 1));
+
+    edgeCacheExact.resize(edgeCacheH.size());
+    for (decltype(edgeCacheH)::size_type row = 0; row < edgeCacheH.size();
+         row++)
+    {
+        edgeCacheExact[row].resize(edgeCacheH[row].size());
+        for (decltype(edgeCacheH)::size_type column = 0;
+             column < edgeCacheH[row].size(); column++)
+            edgeCacheExact[row][column] =
+                quantise_distance(edgeCacheH[row][column]);
+    }
+}
+
+/* Quantises a single distance (see quantise_edge_cache). */
+ExactFitness Problem::quantise_distance(float distance)
+{
+    auto scaled = static_cast<double>(distance) * fitnessScale;
+    if (!(scaled < static_cast<double>(exactDistanceCap)))
+        return exactDistanceCap;
+    return std::llround(scaled);
+}
+
+/* As quantise_edge_cache, but only for the rows (and the matching columns)
+ * of the edge cache at `hIndices`, for when only they have changed. */
+void Problem::quantise_edge_cache(const std::vector<unsigned>& hIndices)
+{
+    for (const auto& hIndex : hIndices)
+        for (decltype(edgeCacheH)::size_type other = 0;
+             other < edgeCacheH.size(); other++)
+        {
+            edgeCacheExact[hIndex][other] =
+                quantise_distance(edgeCacheH[hIndex][other]);
+            edgeCacheExact[other][hIndex] =
+                quantise_distance(edgeCacheH[other][hIndex]);
+        }
+}
+
+/* Builds a compressed-sparse-row view of the application graph, where the
+ * neighbours of the application node at index `i` in nodeAs are at indices
+ * `targets[offsets[i]]` to `targets[offsets[i + 1] - 1]`. This is useful for
+ * algorithms that need to address application nodes by index (and mark them
+ * in flat arrays) as opposed to by pointer. */
+void Problem::build_a_adjacency(std::vector<unsigned>& offsets,
+                                std::vector<unsigned>& targets)
+{
+    /* Pointer-to-index lookup. */
+    std::unordered_map<const NodeA*, unsigned> indexGivenPtr;
+    indexGivenPtr.reserve(nodeAs.size());
+    for (decltype(nodeAs)::size_type aIndex = 0; aIndex < nodeAs.size();
+         aIndex++)
+        indexGivenPtr[nodeAs[aIndex].get()] = static_cast<unsigned>(aIndex);
+
+    offsets.clear();
+    targets.clear();
+    offsets.reserve(nodeAs.size() + 1);
+    offsets.push_back(0);
+    for (const auto& nodeA : nodeAs)
+    {
+        for (const auto& neighbourPtr : nodeA->neighbours)
+            targets.push_back(indexGivenPtr.at(neighbourPtr.lock().get()));
+        offsets.push_back(static_cast<unsigned>(targets.size()));
+    }
+}
+
+/* Lists the indices of hardware nodes that are in service, in ascending
+ * order. Initial conditions place application nodes on these only. */
+void Problem::list_available_h_nodes(std::vector<unsigned>& hIndices)
+{
+    hIndices.clear();
+    for (unsigned hIndex = 0; hIndex < nodeHs.size(); hIndex++)
+        if (nodeHs[hIndex]->available) hIndices.push_back(hIndex);
+}
+
 /* Defines an initial state for the annealer, but populating the location field
  * in each application node, and the contents field in each hardware
  * node. Application nodes are assigned to hardware nodes in the order they are
- * in the problem stucture; each hardware node is "filled up" to pMax entries
- * in turn.
+ * in the problem stucture; each available hardware node is "filled up" to pMax
+ * entries in turn.
  *
  * Falls over violently if there are too many application nodes for the
  * hardware graph to hold.
@@ -96,8 +204,9 @@ void Problem::initial_condition_bucket()
     /* Place each application node in turn. */
     for (const auto& selA : nodeAs)
     {
-        /* If the hardware node is full, move to the next one. */
-        if ((*selHIt)->contents.size() >= pMax)
+        /* If the hardware node is full or out of service, move to the next
+         * one. */
+        while ((*selHIt)->contents.size() >= pMax or !(*selHIt)->available)
             selHIt++;  /* Falls over violently if there are too many
                         * application nodes for the hardware graph to hold. */
 
@@ -109,11 +218,21 @@ void Problem::initial_condition_bucket()
     log("Initial condition applied.");
 }
 
+/* Unmaps every application node, so that an initial condition can be
+ * applied again (see sweeps in main.cpp). */
+void Problem::clear_locations()
+{
+    for (const auto& nodeH : nodeHs) nodeH->contents.clear();
+    for (const auto& nodeA : nodeAs) nodeA->location.reset();
+}
+
 /* Defines an initial state for the annealer, by populating the location field
  * in each application node, and the contents field in each hardware
  * node. Assignments of application nodes to hardware nodes is done at random,
- * but data structure integrity is not compromised. This method also respects
- * the pMax field defined in the problem.
+ * but data structure integrity is not compromised, and only available hardware
+ * nodes are used. This method also respects the pMax field defined in the
+ * problem. Runs in time linear in the number of application and hardware
+ * nodes.
  *
  * This initialiser assumes that the aforementioned fields have not been
  * defined. */
@@ -121,59 +240,367 @@ void Problem::initial_condition_random()
 {
     log("Applying random initial condition.");
 
-    /* To make random selection faster, define a container of hardware nodes
-     * that can fit more application nodes in them. Elements will leave this
-     * container as they become populated. */
-    std::list<std::weak_ptr<NodeH>> nonEmpty;
-
-    /* Populate the container with all nodes. */
-    for (const auto& hNode : nodeHs) nonEmpty.push_back(hNode);
+    /* To make random selection fast, define a dense container holding the
+     * indices of available hardware nodes that can fit more application
+     * nodes in them. Elements leave this container as they become populated,
+     * by swapping them with the last element and popping it (so selection
+     * and removal are both constant-time). The order of elements in this
+     * container does not matter, because we select from it uniformly. */
+    std::vector<unsigned> nonFull;
+    list_available_h_nodes(nonFull);
 
     /* Likewise for application nodes, though we don't select from this
      * container - we shuffle it. */
-    std::vector<std::weak_ptr<NodeA>> toPlace;
-    for (const auto& aNode : nodeAs) toPlace.push_back(aNode);
+    std::vector<unsigned> toPlace(nodeAs.size());
+    std::iota(toPlace.begin(), toPlace.end(), 0);
     std::shuffle(toPlace.begin(), toPlace.end(), rng);
 
     /* Place each application node in turn. */
-    for (const auto& selA : toPlace)
+    for (const auto& aIndex : toPlace)
     {
         /* Select a hardware node at random that is not yet full. */
-        auto selH = nonEmpty.begin();
-        std::uniform_int_distribution<decltype(nonEmpty)::size_type>
-            distribution(0, nonEmpty.size() - 1);
-        std::advance(selH, distribution(rng));
+        std::uniform_int_distribution<decltype(nonFull)::size_type>
+            distribution(0, nonFull.size() - 1);
+        auto roll = distribution(rng);
+        const auto& selA = nodeAs[aIndex];
+        const auto& selH = nodeHs[nonFull[roll]];
 
         /* Map */
-        selA.lock()->location = *selH;
-        selH->lock()->contents.insert(selA.lock().get());
+        selA->location = std::weak_ptr(selH);
+        selH->contents.insert(selA.get());
 
         /* Remove the hardware node if it is full. */
-        if (selH->lock()->contents.size() >= pMax) nonEmpty.erase(selH);
+        if (selH->contents.size() >= pMax)
+        {
+            nonFull[roll] = nonFull.back();
+            nonFull.pop_back();
+        }
     }
 
     log("Initial condition applied.");
 }
 
+/* Defines an initial state for the annealer from a previous anneal, by
+ * reading a CSV file written by write_a_to_h_map. Application nodes that
+ * appear in that file (by name) keep their previous hardware node (by name),
+ * as long as it exists and has room. The rest (e.g. new application nodes)
+ * are placed greedily near their neighbours, in breadth-first order from the
+ * nodes that were placed from the file. Entries for application nodes that no
+ * longer exist are ignored. Returns false, having placed nothing, if the
+ * file can't be read, writing why to `errors`.
+ *
+ * This initialiser assumes that the location and contents fields have not been
+ * defined. Requires the edge cache to be populated. */
+bool Problem::initial_condition_warm(const std::string_view& path,
+                                     std::stringstream& errors)
+{
+    std::ifstream in(path.data());
+    if (!in)
+    {
+        errors << "Could not open warm start file '" << path << "'.\n";
+        return false;
+    }
+
+    {
+        std::stringstream message;
+        message << "Applying warm initial condition from '" << path.data()
+                << "'.";
+        log(message.str());
+    }
+
+    /* Name-to-node lookups. */
+    std::unordered_map<std::string, decltype(nodeAs)::size_type>
+        aIndexGivenName;
+    aIndexGivenName.reserve(nodeAs.size());
+    for (decltype(nodeAs)::size_type aIndex = 0; aIndex < nodeAs.size();
+         aIndex++) aIndexGivenName[nodeAs[aIndex]->name] = aIndex;
+    std::unordered_map<std::string, decltype(nodeHs)::size_type>
+        hIndexGivenName;
+    hIndexGivenName.reserve(nodeHs.size());
+    for (decltype(nodeHs)::size_type hIndex = 0; hIndex < nodeHs.size();
+         hIndex++) hIndexGivenName[nodeHs[hIndex]->name] = hIndex;
+
+    /* Read the map, skipping the header. */
+    std::string line;
+    std::getline(in, line);
+    unsigned long long kept = 0;
+    while (std::getline(in, line))
+    {
+        auto comma = line.find(',');
+        if (comma == std::string::npos) continue;
+        auto aFound = aIndexGivenName.find(line.substr(0, comma));
+        auto hFound = hIndexGivenName.find(line.substr(comma + 1));
+        if (aFound == aIndexGivenName.end() or
+            hFound == hIndexGivenName.end()) continue;
+
+        const auto& nodeA = nodeAs[aFound->second];
+        const auto& nodeH = nodeHs[hFound->second];
+        if (nodeA->location.lock() or nodeH->contents.size() >= pMax or
+            !nodeH->available) continue;
+        nodeA->location = std::weak_ptr(nodeH);
+        nodeH->contents.insert(nodeA.get());
+        kept++;
+    }
+
+    /* Place the rest greedily, starting with those that neighbour a placed
+     * application node, so that chains of new application nodes grow out
+     * from the placement we already have. */
+    std::vector<unsigned> offsets;
+    std::vector<unsigned> targets;
+    build_a_adjacency(offsets, targets);
+    std::vector<bool> queued(nodeAs.size(), false);
+    std::vector<unsigned> queue;
+    for (unsigned aIndex = 0; aIndex < nodeAs.size(); aIndex++)
+    {
+        if (!nodeAs[aIndex]->location.lock()) continue;
+        queued[aIndex] = true;
+        for (auto edge = offsets[aIndex]; edge < offsets[aIndex + 1]; edge++)
+        {
+            if (queued[targets[edge]] or
+                nodeAs[targets[edge]]->location.lock()) continue;
+            queued[targets[edge]] = true;
+            queue.push_back(targets[edge]);
+        }
+    }
+
+    /* If the search runs dry (a component with no placed application nodes),
+     * start again from any unplaced application node. */
+    decltype(queue)::size_type queueHead = 0;
+    unsigned unplaced = 0;
+    LoadOrder loadOrder;
+    build_load_order(loadOrder);
+    while (true)
+    {
+        if (queueHead == queue.size())
+        {
+            while (unplaced < nodeAs.size() and queued[unplaced]) unplaced++;
+            if (unplaced == nodeAs.size()) break;
+            queued[unplaced] = true;
+            queue.push_back(unplaced);
+        }
+
+        auto aIndex = queue[queueHead++];
+        place_greedily(aIndex, loadOrder);
+        for (auto edge = offsets[aIndex]; edge < offsets[aIndex + 1]; edge++)
+        {
+            if (queued[targets[edge]]) continue;
+            queued[targets[edge]] = true;
+            queue.push_back(targets[edge]);
+        }
+    }
+
+    std::stringstream message;
+    message << "Initial condition applied (" << kept
+            << " application node(s) kept, " << queue.size()
+            << " placed greedily).";
+    log(message.str());
+    return true;
+}
+
+/* Orders the available hardware nodes that have room (fewer than pMax
+ * application nodes) by loading, for place_greedily. */
+void Problem::build_load_order(LoadOrder& loadOrder)
+{
+    loadOrder.clear();
+    for (const auto& nodeH : nodeHs)
+        if (nodeH->available and nodeH->contents.size() < pMax)
+            loadOrder.emplace(nodeH->contents.size(), nodeH->index);
+}
+
+/* Places the application node at `aIndex` (which must not be placed already)
+ * on the hardware node that least worsens the fitness, out of the hardware
+ * nodes that hold its neighbours and the least-loaded available hardware
+ * node. Respects pMax. Requires the edge cache to be populated.
+ *
+ * Finding the least-loaded hardware node costs a pass over the hardware
+ * nodes, unless a load order (see build_load_order) is passed, which is then
+ * kept up to date. Placement must not otherwise change while a load order is
+ * in use.
+ *
+ * Aborts if every available hardware node is full. */
+void Problem::place_greedily(decltype(nodeAs)::size_type aIndex)
+{
+    auto leastLoaded = std::min_element(
+        nodeHs.begin(), nodeHs.end(), [](const auto& first, const auto& second)
+        {
+            if (first->available != second->available)
+                return first->available;
+            return first->contents.size() < second->contents.size();
+        });
+    place_near_neighbours(aIndex, (*leastLoaded)->index);
+}
+
+void Problem::place_greedily(decltype(nodeAs)::size_type aIndex,
+                             LoadOrder& loadOrder)
+{
+    /* (If there is no room anywhere, any hardware node will do for the
+     * abort.) */
+    auto hIndex = place_near_neighbours(
+        aIndex, loadOrder.empty() ? 0 : loadOrder.begin()->second);
+    auto loading = nodeHs[hIndex]->contents.size();
+    loadOrder.erase({loading - 1, hIndex});
+    if (loading < pMax) loadOrder.emplace(loading, hIndex);
+}
+
+/* Does the work of place_greedily, given the least-loaded hardware node, and
+ * returns the index of the hardware node it placed on. */
+unsigned Problem::place_near_neighbours(decltype(nodeAs)::size_type aIndex,
+                                        unsigned fallbackHIndex)
+{
+    const auto& nodeA = nodeAs[aIndex];
+
+    /* Where are the neighbours? */
+    std::vector<unsigned> neighbourHIndices;
+    for (const auto& neighbourPtr : nodeA->neighbours)
+    {
+        auto neighbourA = neighbourPtr.lock();
+        if (!neighbourA) continue;
+        auto neighbourH = neighbourA->location.lock();
+        if (neighbourH) neighbourHIndices.push_back(neighbourH->index);
+    }
+
+    /* Candidates - the least-loaded available hardware node, and those
+     * holding neighbours. */
+    auto candidates = neighbourHIndices;
+    candidates.push_back(fallbackHIndex);
+
+    /* Fitness cost of placing the application node on each candidate (recall
+     * that edges are double-counted). */
+    auto bestCost = std::numeric_limits<double>::max();
+    auto bestHIndex = static_cast<unsigned>(nodeHs.size());
+    for (const auto& hIndex : candidates)
+    {
+        auto loading = nodeHs[hIndex]->contents.size();
+        if (loading >= pMax or !nodeHs[hIndex]->available) continue;
+        double cost = 2 * static_cast<double>(loading) + 1;
+        for (const auto& neighbourHIndex : neighbourHIndices)
+            cost += 2 * static_cast<double>(
+                edgeCacheH[hIndex][neighbourHIndex]);
+        if (cost < bestCost)
+        {
+            bestCost = cost;
+            bestHIndex = hIndex;
+        }
+    }
+
+    /* Nowhere to go - even the least-loaded hardware node is full (or there
+     * is no available hardware at all). */
+    if (bestHIndex == nodeHs.size())
+    {
+        std::stringstream message;
+        message << "No available hardware node has room for application "
+                << "node '" << nodeA->name << "' (pMax is " << pMax
+                << "). Aborting.";
+        log(message.str());
+        std::cerr << message.str() << std::endl;
+        std::abort();
+    }
+
+    const auto& nodeH = nodeHs[bestHIndex];
+    nodeA->location = std::weak_ptr(nodeH);
+    nodeH->contents.insert(nodeA.get());
+    return bestHIndex;
+}
+
 /* Transforms the state by moving the selected application node to the selected
  * hardware node. The iterators pass as arguments are unchanged, and are not
- * checked for validity. */
+ * checked for validity. The application node leaves its current hardware
+ * node, takes the selected hardware node as its location, and joins its
+ * contents (note that the shared pointers will not be emptied - they are only
+ * emptied on destruction of the Problem object). The fixed-degree view and
+ * published placement (if any) are kept in step. */
 void Problem::transform(decltype(nodeAs)::iterator& selA,
                         decltype(nodeHs)::iterator& selH,
                         decltype(nodeHs)::iterator& oldH)
 {
-    /* Remove this application node from its current hardware node. Note that
-     * the shared pointers will not be emptied - they are only emptied on
-     * destruction of the Problem object. */
-    (*oldH)->contents.erase(selA->get());
+    if (fixedDegree != 0) transform_with<true, true>(selA, selH, oldH);
+    else transform_with<false, true>(selA, selH, oldH);
+}
+
+/* Writes the index of the hardware node holding each application node (by
+ * index) into `aToH`, resizing it to fit. Every application node must be
+ * placed. */
+void Problem::snapshot_locations(std::vector<unsigned>& aToH)
+{
+    aToH.resize(nodeAs.size());
+    for (decltype(nodeAs)::size_type aIndex = 0; aIndex < nodeAs.size();
+         aIndex++)
+        aToH[aIndex] = nodeAs[aIndex]->location.lock()->index;
+}
+
+/* Moves application nodes back to where they were when `aToH` was written by
+ * snapshot_locations. Only application nodes that have moved since are
+ * touched. The application graph must not have changed in the meantime. Not
+ * thread safe. */
+void Problem::restore_locations(const std::vector<unsigned>& aToH)
+{
+    for (decltype(nodeAs)::size_type aIndex = 0; aIndex < nodeAs.size();
+         aIndex++)
+    {
+        const auto& nodeA = nodeAs[aIndex];
+        auto oldH = nodeA->location.lock();
+        if (oldH->index == aToH[aIndex]) continue;
+        const auto& selH = nodeHs[aToH[aIndex]];
+        oldH->contents.erase(nodeA.get());
+        nodeA->location = std::weak_ptr(selH);
+        selH->contents.insert(nodeA.get());
+        if (fixedDegree != 0) fixedLocations[aIndex] = selH->index;
+        if (!publishedLocations.empty())
+            publishedLocations[aIndex].store(selH->index,
+                                             std::memory_order_relaxed);
+    }
+}
+
+/* Returns whether `aToH` (e.g. read from a file) could have been written by
+ * snapshot_locations for this problem, in which case it can be restored: it
+ * places every application node on an available hardware node, with no more
+ * than pMax application nodes on each. */
+bool Problem::valid_locations(const std::vector<unsigned>& aToH)
+{
+    if (aToH.size() != nodeAs.size()) return false;
+    std::vector<unsigned> loads(nodeHs.size(), 0);
+    for (auto hIndex : aToH)
+    {
+        if (hIndex >= nodeHs.size() or !nodeHs[hIndex]->available or
+            ++loads[hIndex] > pMax) return false;
+    }
+    return true;
+}
+
+/* Publishes the placement, so that it can be read (with
+ * read_published_locations) from another thread while application nodes are
+ * being transformed. Every application node must be placed, and the
+ * application graph must not change until the placement is withdrawn. */
+void Problem::publish_locations()
+{
+    std::vector<unsigned> aToH;
+    snapshot_locations(aToH);
+    publishedLocations = std::vector<std::atomic<unsigned>>(aToH.size());
+    for (decltype(aToH)::size_type aIndex = 0; aIndex < aToH.size();
+         aIndex++)
+        publishedLocations[aIndex].store(aToH[aIndex],
+                                         std::memory_order_relaxed);
+}
 
-    /* Assign the selected hardware node to the location field of the selected
-     * application node. */
-    (*selA)->location = std::weak_ptr(*selH);
+/* Stops publishing the placement, so that transformation no longer pays for
+ * it. */
+void Problem::withdraw_locations()
+{
+    publishedLocations.clear();
+    publishedLocations.shrink_to_fit();
+}
 
-    /* Append the selected application node to the contents field of the
-     * selected hardware node. */
-    (*selH)->contents.insert(selA->get());
+/* Copies the published placement into `aToH`, resizing it to fit. Safe to
+ * call while other threads transform, but there is no ordering between the
+ * loads, so a copy taken mid-anneal may mix locations from before and after
+ * a given transformation (and so may briefly exceed pMax somewhere). */
+void Problem::read_published_locations(std::vector<unsigned>& aToH)
+{
+    aToH.resize(publishedLocations.size());
+    for (decltype(publishedLocations)::size_type aIndex = 0;
+         aIndex < publishedLocations.size(); aIndex++)
+        aToH[aIndex] =
+            publishedLocations[aIndex].load(std::memory_order_relaxed);
 }
 
 /* Computes and returns the locality fitness associated with a given
@@ -189,8 +616,8 @@ float Problem::compute_app_node_locality_fitness(const NodeA& nodeA)
     auto rootHIndex = nodeA.location.lock()->index;
 
     /* Edge cache row for this hardware node (to avoid getting it multiple
-     * times) */
-    auto edgeCacheRow = edgeCacheH.at(rootHIndex);
+     * times, and without copying it) */
+    const auto& edgeCacheRow = edgeCacheH.at(rootHIndex);
 
     /* Iterate over each application node. */
     for (const auto& neighbourPtr : nodeA.neighbours)
@@ -215,32 +642,123 @@ float Problem::compute_hw_node_clustering_fitness(const NodeH& nodeH)
 
 /* Computes and returns the total fitness of the current mapping for this
  * solution. */
-float Problem::compute_total_fitness()
+float Problem::compute_total_fitness(unsigned numThreads)
 {
     return compute_total_clustering_fitness() +
-        compute_total_locality_fitness();
+        compute_total_locality_fitness(numThreads);
 }
 
 /* Computes and returns the total clustering fitness of the current mapping for
- * this solution. */
+ * this solution. Accumulates in double precision, because the terms are large
+ * and many. */
 float Problem::compute_total_clustering_fitness()
 {
-    float returnValue = 0;
+    double returnValue = 0;
     for (const auto& nodeH : nodeHs)
         returnValue += compute_hw_node_clustering_fitness(*nodeH);
+    return static_cast<float>(returnValue);
+}
+
+/* Sums `sum_slice(first, last)` over contiguous slices of [0, size), one per
+ * thread, if there is enough work to go around. */
+template <class Sum, class SumSlice>
+static Sum reduce_in_parallel(std::size_t size, unsigned numThreads,
+                              SumSlice sum_slice)
+{
+    constexpr std::size_t minimumSlice = 1 << 14;
+    numThreads = static_cast<unsigned>(std::clamp<std::size_t>(
+        size / minimumSlice, 1, std::max(numThreads, 1u)));
+    if (numThreads == 1) return sum_slice(0, size);
+
+    std::vector<Sum> partials(numThreads);
+    std::vector<std::thread> threads;
+    for (unsigned thread = 0; thread < numThreads; thread++)
+        threads.emplace_back([&, thread]()
+        {
+            partials[thread] = sum_slice(size * thread / numThreads,
+                                         size * (thread + 1) / numThreads);
+        });
+    for (auto& thread : threads) thread.join();
+    return std::accumulate(partials.begin(), partials.end(), Sum(0));
+}
+
+/* Sums the locality fitness of the application nodes at indices [first,
+ * last), given an edge cache (float or exact). Reads the fixed-degree view
+ * (flat arrays) if it has been built, and walks neighbours otherwise. */
+template <class Sum, class Distance>
+Sum Problem::sum_locality_fitness(
+    const std::vector<std::vector<Distance>>& edgeCache,
+    std::size_t first, std::size_t last)
+{
+    Sum returnValue = 0;
+    if (fixedDegree != 0)
+    {
+        auto padding = static_cast<unsigned>(nodeAs.size());
+        for (auto aIndex = first; aIndex < last; aIndex++)
+        {
+            const auto& edgeCacheRow = edgeCache[fixedLocations[aIndex]];
+            const auto* neighbours =
+                fixedNeighbours.data() + aIndex * fixedDegree;
+            for (unsigned slot = 0; slot < fixedDegree; slot++)
+                if (neighbours[slot] != padding)
+                    returnValue -=
+                        edgeCacheRow[fixedLocations[neighbours[slot]]];
+        }
+        return returnValue;
+    }
+
+    for (auto aIndex = first; aIndex < last; aIndex++)
+    {
+        const auto& nodeA = nodeAs[aIndex];
+        const auto& edgeCacheRow = edgeCache[nodeA->location.lock()->index];
+        for (const auto& neighbourPtr : nodeA->neighbours)
+            returnValue -= edgeCacheRow[
+                neighbourPtr.lock()->location.lock()->index];
+    }
     return returnValue;
 }
 
 /* Computes and returns the total locality fitness of the current mapping for
- * this solution. */
-float Problem::compute_total_locality_fitness()
+ * this solution, using `numThreads` threads (each summing a slice of the
+ * application nodes in double precision). */
+float Problem::compute_total_locality_fitness(unsigned numThreads)
 {
-    float returnValue = 0;
-    for (const auto& nodeA : nodeAs)
-        returnValue += compute_app_node_locality_fitness(*nodeA);
+    return static_cast<float>(reduce_in_parallel<double>(
+        nodeAs.size(), numThreads,
+        [this](std::size_t first, std::size_t last)
+        {return sum_locality_fitness<double>(edgeCacheH, first, last);}));
+}
+
+/* Exact counterparts of compute_hw_node_clustering_fitness,
+ * compute_total_clustering_fitness and compute_total_locality_fitness (see
+ * compute_app_node_locality_fitness_exact). */
+ExactFitness Problem::compute_hw_node_clustering_fitness_exact(
+    const NodeH& nodeH)
+{
+    auto size = static_cast<ExactFitness>(nodeH.contents.size());
+    return -size * size * fitnessScale;
+}
+
+ExactFitness Problem::compute_total_clustering_fitness_exact()
+{
+    ExactFitness returnValue = 0;
+    for (const auto& nodeH : nodeHs)
+        returnValue += compute_hw_node_clustering_fitness_exact(*nodeH);
     return returnValue;
 }
 
+ExactFitness Problem::compute_total_locality_fitness_exact(
+    unsigned numThreads)
+{
+    return reduce_in_parallel<ExactFitness>(
+        nodeAs.size(), numThreads,
+        [this](std::size_t first, std::size_t last)
+        {
+            return sum_locality_fitness<ExactFitness>(edgeCacheExact, first,
+                                                      last);
+        });
+}
+
 /* Checks the integrity of locks in the data structure.
  *
  * Specifically, this method returns true if no nodes are locked, and false
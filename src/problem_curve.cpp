@@ -0,0 +1,215 @@
+/* Methods defined in this TU construct an initial condition by ordering both
+ * graphs along a space-filling (Hilbert) curve, and placing contiguous
+ * segments of the application ordering onto consecutive hardware nodes in
+ * the hardware ordering. Nodes that are close on the curve are close in
+ * space, so neighbouring application nodes tend to land on the same, or
+ * nearby, hardware nodes.
+ *
+ * Positions are normalised to the bounding box of each graph independently,
+ * so that the application geometry is stretched over the hardware geometry.
+ * Nodes without positions (see nodes.hpp) are ordered without geometry:
+ * application nodes by breadth-first search, and hardware nodes by index. */
+
+#include "problem.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+/* Number of bits per axis used to quantise positions onto the curve. */
+constexpr unsigned curveOrder = 16;
+
+/* Distance along a Hilbert curve of order curveOrder, given a quantised
+ * position. */
+static unsigned long long hilbert_index(unsigned long long x,
+                                        unsigned long long y)
+{
+    constexpr unsigned long long side = 1ull << curveOrder;
+    unsigned long long index = 0;
+    for (auto half = side / 2; half > 0; half /= 2)
+    {
+        unsigned long long rx = (x & half) > 0;
+        unsigned long long ry = (y & half) > 0;
+        index += half * half * ((3 * rx) ^ ry);
+
+        /* Rotate the quadrant so that the curve stays continuous. */
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return index;
+}
+
+/* Orders indices by Hilbert index, given positions of each item. Positions
+ * are quantised over their bounding box. */
+static void order_positions(const std::vector<float>& horiz,
+                            const std::vector<float>& verti,
+                            std::vector<unsigned>& order)
+{
+    auto [horizMin, horizMax] = std::minmax_element(horiz.begin(),
+                                                    horiz.end());
+    auto [vertiMin, vertiMax] = std::minmax_element(verti.begin(),
+                                                    verti.end());
+    constexpr double cells = (1ull << curveOrder) - 1;
+    double horizScale = *horizMax > *horizMin ?
+        cells / (*horizMax - *horizMin) : 0;
+    double vertiScale = *vertiMax > *vertiMin ?
+        cells / (*vertiMax - *vertiMin) : 0;
+
+    std::vector<unsigned long long> keys(horiz.size());
+    for (decltype(keys)::size_type index = 0; index < keys.size(); index++)
+        keys[index] = hilbert_index(
+            static_cast<unsigned long long>(
+                (horiz[index] - *horizMin) * horizScale),
+            static_cast<unsigned long long>(
+                (verti[index] - *vertiMin) * vertiScale));
+
+    order.resize(horiz.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&keys](unsigned first, unsigned second)
+              {
+                  if (keys[first] != keys[second])
+                      return keys[first] < keys[second];
+                  return first < second;
+              });
+}
+
+/* Defines an initial state for the annealer by space-filling curve ordering,
+ * by populating the location field in each application node, and the
+ * contents field in each hardware node. Application nodes are spread as
+ * evenly as possible over the available hardware nodes, so pMax is respected
+ * if the hardware graph can hold the application graph at all.
+ *
+ * This initialiser assumes that the aforementioned fields have not been
+ * defined. */
+void Problem::initial_condition_curve()
+{
+    log("Applying space-filling curve initial condition.");
+
+    std::vector<unsigned> aOrder;
+    std::vector<unsigned> hOrder;
+    order_a_along_curve(aOrder);
+    order_h_along_curve(hOrder);
+    std::erase_if(hOrder, [this](unsigned hIndex)
+                  {return !nodeHs[hIndex]->available;});
+
+    /* Hardware node `hRank` (in curve order) receives the application nodes
+     * from `aOrder[(aSize * hRank) / hSize]` up to (but excluding)
+     * `aOrder[(aSize * (hRank + 1)) / hSize]`. */
+    unsigned long long aSize = aOrder.size();
+    unsigned long long hSize = hOrder.size();
+    for (decltype(hSize) hRank = 0; hRank < hSize; hRank++)
+    {
+        const auto& nodeH = nodeHs[hOrder[hRank]];
+        for (auto aRank = (aSize * hRank) / hSize;
+             aRank < (aSize * (hRank + 1)) / hSize; aRank++)
+        {
+            const auto& nodeA = nodeAs[aOrder[aRank]];
+            nodeA->location = std::weak_ptr(nodeH);
+            nodeH->contents.insert(nodeA.get());
+        }
+    }
+
+    log("Initial condition applied.");
+}
+
+/* Orders application nodes (by index) along the curve if they all have
+ * positions. Otherwise, orders them by breadth-first search from a
+ * pseudo-peripheral node of each connected component in turn. */
+void Problem::order_a_along_curve(std::vector<unsigned>& order)
+{
+    bool positioned = std::all_of(
+        nodeAs.begin(), nodeAs.end(), [](const auto& nodeA)
+        {return nodeA->posHoriz >= 0 and nodeA->posVerti >= 0;});
+
+    if (positioned and !nodeAs.empty())
+    {
+        std::vector<float> horiz;
+        std::vector<float> verti;
+        horiz.reserve(nodeAs.size());
+        verti.reserve(nodeAs.size());
+        for (const auto& nodeA : nodeAs)
+        {
+            horiz.push_back(nodeA->posHoriz);
+            verti.push_back(nodeA->posVerti);
+        }
+        order_positions(horiz, verti, order);
+        return;
+    }
+
+    log("Not all application nodes have positions - ordering application "
+        "nodes by breadth-first search instead.");
+    std::vector<unsigned> offsets;
+    std::vector<unsigned> targets;
+    build_a_adjacency(offsets, targets);
+
+    /* Visitation stamps: zero is unvisited, one is visited by the search for
+     * a pseudo-peripheral node, and two is ordered. */
+    std::vector<unsigned char> stamps(nodeAs.size(), 0);
+    order.clear();
+    order.reserve(nodeAs.size());
+    auto search = [&](unsigned root, unsigned char stamp,
+                      std::vector<unsigned>& queue)
+    {
+        auto head = queue.size();
+        stamps[root] = stamp;
+        queue.push_back(root);
+        for (; head < queue.size(); head++)
+        {
+            auto aIndex = queue[head];
+            for (auto edge = offsets[aIndex]; edge < offsets[aIndex + 1];
+                 edge++)
+            {
+                if (stamps[targets[edge]] < stamp)
+                {
+                    stamps[targets[edge]] = stamp;
+                    queue.push_back(targets[edge]);
+                }
+            }
+        }
+    };
+
+    std::vector<unsigned> component;
+    for (unsigned aIndex = 0; aIndex < nodeAs.size(); aIndex++)
+    {
+        if (stamps[aIndex] != 0) continue;
+        component.clear();
+        search(aIndex, 1, component);
+        search(component.back(), 2, order);
+    }
+}
+
+/* Orders hardware nodes (by index) along the curve if they all have
+ * positions. Otherwise, orders them by index. */
+void Problem::order_h_along_curve(std::vector<unsigned>& order)
+{
+    bool positioned = std::all_of(
+        nodeHs.begin(), nodeHs.end(), [](const auto& nodeH)
+        {return nodeH->posHoriz >= 0 and nodeH->posVerti >= 0;});
+
+    if (positioned and !nodeHs.empty())
+    {
+        std::vector<float> horiz;
+        std::vector<float> verti;
+        horiz.reserve(nodeHs.size());
+        verti.reserve(nodeHs.size());
+        for (const auto& nodeH : nodeHs)
+        {
+            horiz.push_back(nodeH->posHoriz);
+            verti.push_back(nodeH->posVerti);
+        }
+        order_positions(horiz, verti, order);
+        return;
+    }
+
+    log("Not all hardware nodes have positions - ordering hardware nodes by "
+        "index instead.");
+    order.resize(nodeHs.size());
+    std::iota(order.begin(), order.end(), 0);
+}
@@ -0,0 +1,640 @@
+/* Methods defined in this TU read and write problems as files, so that a
+ * problem can be chosen at runtime rather than compiled in (see
+ * problem_definition_wrapper.cpp).
+ *
+ * The text format has one record per line, with fields separated by spaces
+ * or tabs. Blank lines, and lines beginning with '#', are ignored. Records
+ * are:
+ *
+ * - "name <NAME>": The name of the problem.
+ *
+ * - "pmax <P>": The maximum number of application nodes per hardware node.
+ *
+ * - "h <NAME> [<HORIZ_POS> <VERTI_POS> [<ADDRESS>...]]": A hardware node,
+ *   indexed in the order they appear (from zero), with an optional position
+ *   and (if positioned) an optional address (see NodeH).
+ *
+ * - "he <FIRST> <SECOND> <WEIGHT>": A hardware edge, between nodes given by
+ *   index.
+ *
+ * - "hoff <INDEX>": A hardware node, given by index, that is out of service
+ *   (see disable_h_node). Edges to it are ignored when the edge cache is
+ *   computed.
+ *
+ * - "a <NAME> [<HORIZ_POS> <VERTI_POS>]": An application node, indexed as
+ *   hardware nodes are.
+ *
+ * - "ae <FIRST> <SECOND>": An application edge, between nodes given by
+ *   index. Edges are undirected, so each node becomes a neighbour of the
+ *   other.
+ *
+ * Names may not contain whitespace.
+ *
+ * The binary format holds the same problem as flat arrays (see
+ * write_problem_binary), optionally with the hardware edge cache, so that
+ * loading it involves no parsing (and no Floyd-Warshall, if the cache is
+ * included). load_problem tells the formats apart by their first bytes. */
+
+#include "problem.hpp"
+
+#include "binary_io.hpp"
+#include "build_helpers.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+
+/* What one thread makes of its chunk of a problem file, before the chunks are
+ * stitched together. Nodes are held as views into the file. */
+struct ParsedNode
+{
+    std::string_view name;
+    float posHoriz = -1;
+    float posVerti = -1;
+    std::vector<unsigned> address;
+};
+
+struct ParsedChunk
+{
+    std::string_view name;
+    bool hasPMax = false;
+    unsigned pMax = 0;
+    std::vector<ParsedNode> nodeAs;
+    std::vector<ParsedNode> nodeHs;
+    std::vector<std::pair<unsigned, unsigned>> edgeAs;
+    std::vector<std::tuple<unsigned, unsigned, float>> edgeHs;
+    std::vector<unsigned> unavailableHs;
+
+    /* Lines in the chunk, and the first bad line (if any, counted from the
+     * start of the chunk) and what was wrong with it. */
+    unsigned long long lines = 0;
+    unsigned long long errorLine = 0;
+    std::string error;
+};
+
+/* Parses the records in a chunk of a problem file. */
+static void parse_chunk(std::string_view text, ParsedChunk& chunk)
+{
+    std::vector<std::string_view> fields;
+    auto fail = [&chunk](const char* error)
+    {
+        chunk.errorLine = chunk.lines;
+        chunk.error = error;
+    };
+
+    while (!text.empty())
+    {
+        auto end = text.find('\n');
+        if (end == std::string_view::npos) end = text.size();
+        auto line = text.substr(0, end);
+        text.remove_prefix(std::min(end + 1, text.size()));
+        chunk.lines++;
+
+        split_fields(line, fields);
+        if (fields.empty() or fields[0][0] == '#') continue;
+        const auto& type = fields[0];
+
+        if (type == "a" or type == "h")
+        {
+            ParsedNode node;
+            node.name = fields.size() > 1 ? fields[1] : "";
+            bool valid = fields.size() == 2 or
+                (fields.size() >= 4 and
+                 parse_field(fields[2], node.posHoriz) and
+                 parse_field(fields[3], node.posVerti));
+            if (type == "a") valid = valid and fields.size() <= 4;
+            for (decltype(fields)::size_type index = 4;
+                 valid and index < fields.size(); index++)
+                valid = parse_field(fields[index],
+                                    node.address.emplace_back());
+            if (!valid) return fail("malformed node");
+            if (type == "a") chunk.nodeAs.push_back(std::move(node));
+            else chunk.nodeHs.push_back(std::move(node));
+        }
+
+        else if (type == "ae")
+        {
+            auto& edge = chunk.edgeAs.emplace_back();
+            if (fields.size() != 3 or
+                !parse_field(fields[1], edge.first) or
+                !parse_field(fields[2], edge.second))
+                return fail("malformed application edge");
+        }
+
+        else if (type == "he")
+        {
+            auto& edge = chunk.edgeHs.emplace_back();
+            if (fields.size() != 4 or
+                !parse_field(fields[1], std::get<0>(edge)) or
+                !parse_field(fields[2], std::get<1>(edge)) or
+                !parse_field(fields[3], std::get<2>(edge)))
+                return fail("malformed hardware edge");
+        }
+
+        else if (type == "hoff")
+        {
+            if (fields.size() != 2 or
+                !parse_field(fields[1], chunk.unavailableHs.emplace_back()))
+                return fail("malformed out-of-service hardware node");
+        }
+
+        else if (type == "pmax")
+        {
+            if (fields.size() != 2 or !parse_field(fields[1], chunk.pMax))
+                return fail("malformed pmax");
+            chunk.hasPMax = true;
+        }
+
+        else if (type == "name")
+        {
+            if (fields.size() != 2) return fail("malformed name");
+            chunk.name = fields[1];
+        }
+
+        else return fail("unknown record type");
+    }
+}
+
+/* Defines this problem from the text file at `path` (see the top of this
+ * file), which replaces anything already defined. The file is read in one go,
+ * and split into `numThreads` chunks (at line boundaries) that are parsed
+ * concurrently. Nodes are then constructed concurrently into their slots, and
+ * neighbour lists are sized before they are filled. Returns false and writes
+ * to `errors` if the file can't be read or is malformed, in which case the
+ * problem is left empty. The edge cache is cleared (unless the file is
+ * binary and includes one). */
+bool Problem::load_problem(const std::string_view& path,
+                           std::stringstream& errors, unsigned numThreads)
+{
+    nodeAs.clear();
+    nodeHs.clear();
+    edgeHs.clear();
+    edgeCacheH.clear();
+    edgeCacheExact.clear();
+
+    std::ifstream in(path.data(), std::ifstream::binary);
+    if (!in)
+    {
+        errors << "Could not open problem file '" << path << "'.\n";
+        return false;
+    }
+
+    char fileMagic[sizeof(binaryMagic)] = {};
+    in.read(fileMagic, sizeof(fileMagic));
+    if (in and std::equal(binaryMagic, binaryMagic + sizeof(binaryMagic),
+                          fileMagic))
+        return load_problem_binary(in, path, errors, numThreads);
+    in.clear();
+    in.seekg(0);
+
+    std::string text(std::filesystem::file_size(path), '\0');
+    in.read(text.data(), static_cast<std::streamsize>(text.size()));
+
+    /* Parse chunks. Each chunk after the first begins after a newline. */
+    numThreads = std::max(numThreads, 1u);
+    std::vector<std::string::size_type> bounds(numThreads + 1, text.size());
+    bounds[0] = 0;
+    for (unsigned thread = 1; thread < numThreads; thread++)
+    {
+        auto newline = text.find('\n', std::max(
+            bounds[thread - 1], text.size() * thread / numThreads));
+        bounds[thread] = newline == std::string::npos ? text.size() :
+            newline + 1;
+    }
+
+    std::vector<ParsedChunk> chunks(numThreads);
+    std::vector<std::thread> threads;
+    std::string_view textView = text;
+    for (unsigned thread = 0; thread < numThreads; thread++)
+        threads.emplace_back([&, thread]()
+        {
+            parse_chunk(textView.substr(bounds[thread],
+                                        bounds[thread + 1] - bounds[thread]),
+                        chunks[thread]);
+        });
+    for (auto& thread : threads) thread.join();
+    threads.clear();
+
+    /* Stitch. Later records win for the name and pMax. */
+    unsigned long long linesBefore = 0;
+    std::vector<decltype(nodeAs)::size_type> aOffsets(numThreads + 1, 0);
+    std::vector<decltype(nodeHs)::size_type> hOffsets(numThreads + 1, 0);
+    decltype(edgeHs)::size_type numEdgeHs = 0;
+    bool hasPMax = false;
+    for (unsigned thread = 0; thread < numThreads; thread++)
+    {
+        const auto& chunk = chunks[thread];
+        if (!chunk.error.empty())
+        {
+            errors << "Problem file '" << path << "', line "
+                   << linesBefore + chunk.errorLine << ": " << chunk.error
+                   << ".\n";
+            return false;
+        }
+        linesBefore += chunk.lines;
+        if (!chunk.name.empty()) name = chunk.name;
+        if (chunk.hasPMax)
+        {
+            pMax = chunk.pMax;
+            hasPMax = true;
+        }
+        aOffsets[thread + 1] = aOffsets[thread] + chunk.nodeAs.size();
+        hOffsets[thread + 1] = hOffsets[thread] + chunk.nodeHs.size();
+        numEdgeHs += chunk.edgeHs.size();
+    }
+
+    if (!hasPMax)
+    {
+        errors << "Problem file '" << path << "' has no pmax.\n";
+        return false;
+    }
+    for (const auto& chunk : chunks)
+    {
+        for (const auto& edge : chunk.edgeAs)
+            if (std::max(edge.first, edge.second) >= aOffsets.back())
+            {
+                errors << "Application edge " << edge.first << " "
+                       << edge.second << " refers to a missing node.\n";
+                return false;
+            }
+        for (const auto& edge : chunk.edgeHs)
+            if (std::max(std::get<0>(edge), std::get<1>(edge)) >=
+                hOffsets.back())
+            {
+                errors << "Hardware edge " << std::get<0>(edge) << " "
+                       << std::get<1>(edge) << " refers to a missing node.\n";
+                return false;
+            }
+        for (const auto& hIndex : chunk.unavailableHs)
+            if (hIndex >= hOffsets.back())
+            {
+                errors << "Out-of-service hardware node " << hIndex
+                       << " is missing.\n";
+                return false;
+            }
+    }
+
+    /* Construct nodes into their slots. */
+    nodeAs.resize(aOffsets.back());
+    nodeHs.resize(hOffsets.back());
+    for (unsigned thread = 0; thread < numThreads; thread++)
+        threads.emplace_back([&, thread]()
+        {
+            auto aIndex = aOffsets[thread];
+            for (const auto& node : chunks[thread].nodeAs)
+                nodeAs[aIndex++] = std::make_shared<NodeA>(
+                    std::string(node.name), node.posHoriz, node.posVerti);
+
+            auto hIndex = hOffsets[thread];
+            for (auto& node : chunks[thread].nodeHs)
+            {
+                auto& nodeH = nodeHs[hIndex] = std::make_shared<NodeH>(
+                    std::string(node.name), static_cast<unsigned>(hIndex),
+                    node.posHoriz, node.posVerti);
+                nodeH->address = std::move(node.address);
+                hIndex++;
+            }
+        });
+    for (auto& thread : threads) thread.join();
+
+    /* Edges, sizing neighbour lists first. */
+    std::vector<unsigned> degrees(nodeAs.size(), 0);
+    for (const auto& chunk : chunks)
+        for (const auto& edge : chunk.edgeAs)
+        {
+            degrees[edge.first]++;
+            degrees[edge.second]++;
+        }
+    for (decltype(nodeAs)::size_type aIndex = 0; aIndex < nodeAs.size();
+         aIndex++)
+        nodeAs[aIndex]->neighbours.reserve(degrees[aIndex]);
+    for (const auto& chunk : chunks)
+        for (const auto& edge : chunk.edgeAs)
+        {
+            nodeAs[edge.first]->neighbours.emplace_back(
+                nodeAs[edge.second]);
+            nodeAs[edge.second]->neighbours.emplace_back(
+                nodeAs[edge.first]);
+        }
+
+    edgeHs.reserve(numEdgeHs);
+    for (const auto& chunk : chunks)
+    {
+        edgeHs.insert(edgeHs.end(), chunk.edgeHs.begin(),
+                      chunk.edgeHs.end());
+        for (const auto& hIndex : chunk.unavailableHs)
+            nodeHs[hIndex]->available = false;
+    }
+    return true;
+}
+
+/* Writes this problem to a text file at `path`, which load_problem reads
+ * back as the same problem. Numbers are written in their shortest form that
+ * reads back exactly. Any existing file is clobbered. */
+void Problem::write_problem(const std::string_view& path)
+{
+    std::stringstream message;
+    message << "Writing problem to file at '" << path.data() << "'.";
+    log(message.str());
+
+    char buffer[32];
+    auto number = [&buffer](auto value)
+    {
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        return std::string_view(buffer, result.ptr - buffer);
+    };
+
+    std::ofstream out(path.data(), std::ofstream::trunc);
+    out << "# Written by PSAP (see problem_files.cpp).\n"
+        << "name " << name << "\n"
+        << "pmax " << pMax << "\n";
+
+    for (const auto& nodeH : nodeHs)
+    {
+        out << "h " << nodeH->name << " " << number(nodeH->posHoriz);
+        out << " " << number(nodeH->posVerti);
+        for (const auto& level : nodeH->address) out << " " << level;
+        out << "\n";
+    }
+    for (const auto& edge : edgeHs)
+    {
+        out << "he " << std::get<0>(edge) << " " << std::get<1>(edge);
+        out << " " << number(std::get<2>(edge)) << "\n";
+    }
+    for (const auto& nodeH : nodeHs)
+        if (!nodeH->available) out << "hoff " << nodeH->index << "\n";
+
+    for (const auto& nodeA : nodeAs)
+    {
+        out << "a " << nodeA->name << " " << number(nodeA->posHoriz);
+        out << " " << number(nodeA->posVerti) << "\n";
+    }
+
+    /* Each neighbour relation is written once, from the lower-indexed side
+     * (neighbour lists are symmetric). */
+    std::vector<unsigned> offsets;
+    std::vector<unsigned> targets;
+    build_a_adjacency(offsets, targets);
+    for (decltype(nodeAs)::size_type aIndex = 0; aIndex < nodeAs.size();
+         aIndex++)
+        for (auto target = offsets[aIndex]; target < offsets[aIndex + 1];
+             target++)
+            if (aIndex < targets[target])
+                out << "ae " << aIndex << " " << targets[target] << "\n";
+    out.close();
+}
+
+/* Names, as one string and the offset of each name in it (plus the end). */
+static void write_names(std::ostream& out, const auto& nodes)
+{
+    std::string names;
+    std::vector<std::uint64_t> offsets = {0};
+    for (const auto& node : nodes)
+    {
+        names += node->name;
+        offsets.push_back(names.size());
+    }
+    write_binary(out, names);
+    write_binary(out, offsets);
+}
+
+/* Writes this problem to a binary file at `path`, which load_problem reads
+ * back as the same problem. If `withEdgeCache` (and the edge cache has been
+ * populated), the cache is included, and is used instead of computing it
+ * again. The file holds (native byte order; see binary_io.hpp):
+ *
+ * - The magic bytes "PSAPPROB", the format version (uint32), and flags
+ *   (uint32, bit zero set if the edge cache is included).
+ *
+ * - The name of the problem, and pMax (uint32).
+ *
+ * - Hardware nodes: names, horizontal and vertical positions, whether each is
+ *   available (uint8), and addresses (offsets into a flat array).
+ *
+ * - Hardware edges: first and second node indices, and weights.
+ *
+ * - Application nodes: names, and horizontal and vertical positions.
+ *
+ * - Application neighbours, in compressed sparse row form: the offset of
+ *   each node's neighbours (plus the end), and the neighbour indices.
+ *
+ * - The edge cache, row by row, if included. */
+void Problem::write_problem_binary(const std::string_view& path,
+                                   bool withEdgeCache)
+{
+    std::stringstream message;
+    message << "Writing binary problem to file at '" << path.data() << "'.";
+    log(message.str());
+
+    withEdgeCache = withEdgeCache and has_edge_cache();
+    std::vector<float> horiz;
+    std::vector<float> verti;
+    auto positions = [&](const auto& nodes)
+    {
+        horiz.clear();
+        verti.clear();
+        for (const auto& node : nodes)
+        {
+            horiz.push_back(node->posHoriz);
+            verti.push_back(node->posVerti);
+        }
+    };
+
+    std::ofstream out(path.data(), std::ofstream::binary |
+                      std::ofstream::trunc);
+    out.write(binaryMagic, sizeof(binaryMagic));
+    write_binary(out, binaryVersion);
+    write_binary(out, std::uint32_t(withEdgeCache ? 1 : 0));
+    write_binary(out, name);
+    write_binary(out, std::uint32_t(pMax));
+
+    std::vector<std::uint8_t> available;
+    std::vector<std::uint64_t> addressOffsets = {0};
+    std::vector<unsigned> addresses;
+    for (const auto& nodeH : nodeHs)
+    {
+        available.push_back(nodeH->available);
+        addresses.insert(addresses.end(), nodeH->address.begin(),
+                         nodeH->address.end());
+        addressOffsets.push_back(addresses.size());
+    }
+    write_names(out, nodeHs);
+    positions(nodeHs);
+    write_binary(out, horiz);
+    write_binary(out, verti);
+    write_binary(out, available);
+    write_binary(out, addressOffsets);
+    write_binary(out, addresses);
+
+    std::vector<unsigned> firsts;
+    std::vector<unsigned> seconds;
+    std::vector<float> weights;
+    for (const auto& edge : edgeHs)
+    {
+        firsts.push_back(std::get<0>(edge));
+        seconds.push_back(std::get<1>(edge));
+        weights.push_back(std::get<2>(edge));
+    }
+    write_binary(out, firsts);
+    write_binary(out, seconds);
+    write_binary(out, weights);
+
+    write_names(out, nodeAs);
+    positions(nodeAs);
+    write_binary(out, horiz);
+    write_binary(out, verti);
+    std::vector<unsigned> offsets;
+    std::vector<unsigned> targets;
+    build_a_adjacency(offsets, targets);
+    write_binary(out, offsets);
+    write_binary(out, targets);
+
+    if (withEdgeCache)
+        for (const auto& row : edgeCacheH) write_binary(out, row);
+    out.close();
+}
+
+/* Defines this problem from a binary file (see write_problem_binary), having
+ * read its magic bytes. Every array is read in one go, and nodes are
+ * constructed concurrently on `numThreads` threads. */
+bool Problem::load_problem_binary(std::ifstream& in,
+                                  const std::string_view& path,
+                                  std::stringstream& errors,
+                                  unsigned numThreads)
+{
+    std::uint32_t version;
+    std::uint32_t flags;
+    std::uint32_t filePMax;
+    std::string hNames;
+    std::vector<std::uint64_t> hNameOffsets;
+    std::vector<float> hHoriz;
+    std::vector<float> hVerti;
+    std::vector<std::uint8_t> hAvailable;
+    std::vector<std::uint64_t> addressOffsets;
+    std::vector<unsigned> addresses;
+    std::vector<unsigned> firsts;
+    std::vector<unsigned> seconds;
+    std::vector<float> weights;
+    std::string aNames;
+    std::vector<std::uint64_t> aNameOffsets;
+    std::vector<float> aHoriz;
+    std::vector<float> aVerti;
+    std::vector<unsigned> offsets;
+    std::vector<unsigned> targets;
+
+    if (!read_binary(in, version) or version != binaryVersion)
+    {
+        errors << "Problem file '" << path << "' has an unsupported binary "
+               << "format version.\n";
+        return false;
+    }
+
+    bool valid = read_binary(in, flags) and read_binary(in, name) and
+        read_binary(in, filePMax) and
+        read_binary(in, hNames) and read_binary(in, hNameOffsets) and
+        read_binary(in, hHoriz) and read_binary(in, hVerti) and
+        read_binary(in, hAvailable) and read_binary(in, addressOffsets) and
+        read_binary(in, addresses) and
+        read_binary(in, firsts) and read_binary(in, seconds) and
+        read_binary(in, weights) and
+        read_binary(in, aNames) and read_binary(in, aNameOffsets) and
+        read_binary(in, aHoriz) and read_binary(in, aVerti) and
+        read_binary(in, offsets) and read_binary(in, targets);
+
+    /* Sizes must agree, offsets must start at zero and never decrease (so
+     * that, ending at the size of what they index, they stay within it), and
+     * indices must be in range. Lengths were checked against the size of the
+     * file as they were read (see read_binary). */
+    auto monotonic = [](const std::vector<std::uint64_t>& values)
+    {
+        return !values.empty() and values.front() == 0 and
+            std::is_sorted(values.begin(), values.end());
+    };
+    auto numHs = hHoriz.size();
+    auto numAs = aHoriz.size();
+    valid = valid and hNameOffsets.size() == numHs + 1 and
+        hVerti.size() == numHs and hAvailable.size() == numHs and
+        addressOffsets.size() == numHs + 1 and
+        addressOffsets.back() == addresses.size() and
+        hNameOffsets.back() == hNames.size() and
+        seconds.size() == firsts.size() and weights.size() == firsts.size() and
+        aNameOffsets.size() == numAs + 1 and aVerti.size() == numAs and
+        aNameOffsets.back() == aNames.size() and
+        offsets.size() == numAs + 1 and offsets.back() == targets.size() and
+        monotonic(hNameOffsets) and monotonic(addressOffsets) and
+        monotonic(aNameOffsets) and offsets.front() == 0 and
+        std::is_sorted(offsets.begin(), offsets.end());
+    for (auto index : firsts) valid = valid and index < numHs;
+    for (auto index : seconds) valid = valid and index < numHs;
+    for (auto index : targets) valid = valid and index < numAs;
+    if (!valid)
+    {
+        errors << "Problem file '" << path << "' is truncated or "
+               << "inconsistent.\n";
+        return false;
+    }
+
+    /* Edge cache, if included. */
+    if (flags & 1)
+    {
+        edgeCacheH.resize(numHs);
+        for (auto& row : edgeCacheH)
+            valid = valid and read_binary(in, row) and row.size() == numHs;
+        if (!valid)
+        {
+            edgeCacheH.clear();
+            errors << "Problem file '" << path << "' has a truncated edge "
+                   << "cache.\n";
+            return false;
+        }
+    }
+
+    pMax = filePMax;
+    edgeHs.reserve(firsts.size());
+    for (decltype(firsts)::size_type index = 0; index < firsts.size();
+         index++)
+        edgeHs.emplace_back(firsts[index], seconds[index], weights[index]);
+
+    nodeHs.resize(numHs);
+    for (decltype(nodeHs)::size_type hIndex = 0; hIndex < numHs; hIndex++)
+    {
+        auto& nodeH = nodeHs[hIndex] = std::make_shared<NodeH>(
+            hNames.substr(hNameOffsets[hIndex],
+                          hNameOffsets[hIndex + 1] - hNameOffsets[hIndex]),
+            static_cast<unsigned>(hIndex), hHoriz[hIndex], hVerti[hIndex]);
+        nodeH->available = hAvailable[hIndex];
+        nodeH->address.assign(addresses.begin() + addressOffsets[hIndex],
+                              addresses.begin() + addressOffsets[hIndex + 1]);
+    }
+
+    /* Application nodes, then their neighbours (which need every node to
+     * exist). */
+    nodeAs.resize(numAs);
+    construct_in_parallel(numAs, numThreads,
+        [&](std::size_t first, std::size_t last)
+        {
+            for (auto aIndex = first; aIndex < last; aIndex++)
+                nodeAs[aIndex] = std::make_shared<NodeA>(
+                    aNames.substr(aNameOffsets[aIndex],
+                                  aNameOffsets[aIndex + 1] -
+                                  aNameOffsets[aIndex]),
+                    aHoriz[aIndex], aVerti[aIndex]);
+        });
+    construct_in_parallel(numAs, numThreads,
+        [&](std::size_t first, std::size_t last)
+        {
+            for (auto aIndex = first; aIndex < last; aIndex++)
+            {
+                auto& neighbours = nodeAs[aIndex]->neighbours;
+                neighbours.reserve(offsets[aIndex + 1] - offsets[aIndex]);
+                for (auto target = offsets[aIndex];
+                     target < offsets[aIndex + 1]; target++)
+                    neighbours.emplace_back(nodeAs[targets[target]]);
+            }
+        });
+
+    /* The exact edge cache depends on the application graph (see
+     * quantise_edge_cache). */
+    if (has_edge_cache()) quantise_edge_cache();
+    return true;
+}
@@ -0,0 +1,59 @@
+/* Methods defined in this TU maintain a fixed-degree view of the application
+ * graph, which the annealers build for the duration of an anneal if every
+ * application node has few enough neighbours (see
+ * Annealer::begin_fixed_degree). The view holds, for each application node,
+ * the indices of its neighbours inline in a row of `fixedDegree` entries
+ * (padded with the index nodeAs.size()), and the index of the hardware node
+ * holding each application node (plus a padding entry, which is always
+ * zero). With those, locality fitness is a fixed-length loop over flat arrays
+ * that the compiler can unroll (see
+ * compute_app_node_locality_fitness_exact), instead of a walk over weak
+ * pointers.
+ *
+ * Transformation keeps the view in step with the placement. Anything else
+ * that moves application nodes, or changes the application graph, must not
+ * be done while the view exists. */
+
+#include "problem.hpp"
+
+#include <algorithm>
+
+/* Returns the largest number of neighbours of any application node. */
+unsigned Problem::compute_max_a_degree()
+{
+    decltype(NodeA::neighbours)::size_type output = 0;
+    for (const auto& nodeA : nodeAs)
+        output = std::max(output, nodeA->neighbours.size());
+    return static_cast<unsigned>(output);
+}
+
+/* Builds the view with rows of `degree` entries, which must be at least
+ * compute_max_a_degree. Every application node must be placed. */
+void Problem::build_fixed_degree_view(unsigned degree)
+{
+    std::vector<unsigned> offsets;
+    std::vector<unsigned> targets;
+    build_a_adjacency(offsets, targets);
+
+    auto padding = static_cast<unsigned>(nodeAs.size());
+    fixedDegree = degree;
+    fixedNeighbours.assign(nodeAs.size() * degree, padding);
+    for (decltype(nodeAs)::size_type aIndex = 0; aIndex < nodeAs.size();
+         aIndex++)
+        std::copy(targets.begin() + offsets[aIndex],
+                  targets.begin() + offsets[aIndex + 1],
+                  fixedNeighbours.begin() + aIndex * degree);
+
+    snapshot_locations(fixedLocations);
+    fixedLocations.push_back(0);
+}
+
+/* Drops the view, so that the placement can change freely again. */
+void Problem::clear_fixed_degree_view()
+{
+    fixedDegree = 0;
+    fixedNeighbours.clear();
+    fixedNeighbours.shrink_to_fit();
+    fixedLocations.clear();
+    fixedLocations.shrink_to_fit();
+}
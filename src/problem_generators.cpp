@@ -0,0 +1,535 @@
+/* Methods defined in this TU generate parametric problems at runtime, so that
+ * scaling studies need neither a problem definition per size nor a problem
+ * file per size (see problem_files.cpp).
+ *
+ * A generator spec is a list of "<KEY>=<VALUE>" fields, separated by spaces
+ * or tabs, pairing an application graph with a hardware graph. Sizes of two
+ * dimensions are written "<OUTER>x<INNER>", and lists are comma-separated.
+ * Keys are (defaults in brackets):
+ *
+ * - "a" (grid): The application graph, one of:
+ *
+ *   - "grid": A square grid (not toroidal), "diameter" (1000) nodes across.
+ *
+ *   - "torus": As "grid", but wrapping around at the edges. The diameter must
+ *     be at least three.
+ *
+ *   - "geometric": A random geometric graph of "nodes" (1000000) nodes,
+ *     scattered uniformly over a square by a generator seeded with "seed"
+ *     (1), each the neighbour of every node within a radius chosen to give a
+ *     mean degree of "degree" (4), less at the edges of the square. Nodes are
+ *     indexed in the order of a coarse grid over the square.
+ *
+ * - "h" (poets): The hardware graph, one of:
+ *
+ *   - "poets": A row of "boxes" (1) POETS boxes, each with "boards" (3x2)
+ *     boards, each with "mailboxes" (4x4) mailboxes, each with "cores" (4)
+ *     cores. Each hardware node is a core, and is connected to every other
+ *     core in its mailbox and in neighbouring mailboxes, with weights given
+ *     by "weights" (0.1,100,800,3200): core to core in a mailbox, then
+ *     between mailboxes on a board, between boards in a box, and between
+ *     boxes. Addresses are board, mailbox and core (see NodeH), with the box
+ *     first if there is more than one.
+ *
+ *   - "ring": A ring of "hnodes" (64) nodes, with edges of weight "weight"
+ *     (8).
+ *
+ * - "pmax": The maximum number of application nodes per hardware node
+ *   (4096 for POETS hardware, for sixteen threads per core with 256
+ *   application nodes each, otherwise twice the mean load).
+ *
+ * - "name": The name of the problem (from the graphs and their sizes).
+ *
+ * The POETS hardware with the default grid (or with a diameter of 1414, and
+ * 3x4 boards) is the poets_box_2d_grid_small (or _big) example, except that
+ * each edge is defined once, where the example defines hardware edges in both
+ * directions and lists each application neighbour twice.
+ *
+ * Application nodes are constructed concurrently on numThreads threads, with
+ * neighbours computed from their indices, and with each neighbour list
+ * reserved to size. */
+
+#include "problem.hpp"
+
+#include "build_helpers.hpp"
+
+#include <array>
+#include <cmath>
+#include <numbers>
+#include <random>
+
+/* Parameters of a generated problem (see the top of this file). */
+struct GeneratorSpec
+{
+    std::string_view application = "grid";
+    unsigned long long diameter = 1000;
+    unsigned long long nodes = 1000000;
+    float degree = 4;
+    Seed seed = 1;
+
+    std::string_view hardware = "poets";
+    unsigned boxes = 1;
+    std::array<unsigned, 2> boards = {3, 2};
+    std::array<unsigned, 2> mailboxes = {4, 4};
+    unsigned cores = 4;
+    std::array<float, 4> weights = {0.1, 100, 800, 3200};
+    unsigned hNodes = 64;
+    float weight = 8;
+
+    unsigned pMax = 0;  /* Zero means the default. */
+    std::string_view name;
+};
+
+/* Parses a list of numbers separated by `separator`, which must have exactly
+ * as many entries as `values`. */
+template <class T, std::size_t Size>
+static bool parse_list(std::string_view field, char separator,
+                       std::array<T, Size>& values)
+{
+    for (std::size_t index = 0; index < Size; index++)
+    {
+        auto end = field.find(separator);
+        if ((end == std::string_view::npos) != (index == Size - 1) or
+            !parse_field(field.substr(0, end), values[index])) return false;
+        field.remove_prefix(end == std::string_view::npos ? field.size() :
+                            end + 1);
+    }
+    return true;
+}
+
+/* Parses a generator spec, writing the first problem to `errors`. */
+static bool parse_spec(std::string_view text, GeneratorSpec& spec,
+                       std::stringstream& errors)
+{
+    std::vector<std::string_view> fields;
+    split_fields(text, fields);
+    for (const auto& field : fields)
+    {
+        auto equals = field.find('=');
+        auto key = field.substr(0, equals);
+        auto value = equals == std::string_view::npos ? std::string_view() :
+            field.substr(equals + 1);
+        bool valid;
+        if (key == "a")
+        {
+            spec.application = value;
+            valid = value == "grid" or value == "torus" or
+                value == "geometric";
+        }
+        else if (key == "h")
+        {
+            spec.hardware = value;
+            valid = value == "poets" or value == "ring";
+        }
+        else if (key == "diameter") valid = parse_field(value, spec.diameter);
+        else if (key == "nodes") valid = parse_field(value, spec.nodes);
+        else if (key == "degree") valid = parse_field(value, spec.degree);
+        else if (key == "seed") valid = parse_field(value, spec.seed);
+        else if (key == "boxes") valid = parse_field(value, spec.boxes);
+        else if (key == "boards")
+            valid = parse_list(value, 'x', spec.boards);
+        else if (key == "mailboxes")
+            valid = parse_list(value, 'x', spec.mailboxes);
+        else if (key == "cores") valid = parse_field(value, spec.cores);
+        else if (key == "weights")
+            valid = parse_list(value, ',', spec.weights);
+        else if (key == "hnodes") valid = parse_field(value, spec.hNodes);
+        else if (key == "weight") valid = parse_field(value, spec.weight);
+        else if (key == "pmax") valid = parse_field(value, spec.pMax);
+        else if (key == "name")
+        {
+            spec.name = value;
+            valid = !value.empty();
+        }
+        else
+        {
+            errors << "Generator spec has unknown key '" << key << "'.\n";
+            return false;
+        }
+
+        if (!valid)
+        {
+            errors << "Generator spec has bad value '" << value
+                   << "' for key '" << key << "'.\n";
+            return false;
+        }
+    }
+
+    /* Sizes. Application nodes are indexed as unsigned (see
+     * build_a_adjacency). */
+    bool torus = spec.application == "torus";
+    auto maxNodes = std::numeric_limits<unsigned>::max();
+    if ((spec.application == "geometric" and
+         (spec.nodes == 0 or spec.nodes > maxNodes or
+          !(spec.degree > 0))) or
+        (spec.application != "geometric" and
+         (spec.diameter < (torus ? 3u : 1u) or
+          spec.diameter > maxNodes / spec.diameter)))
+    {
+        errors << "Generator spec has a bad size for its application "
+               << "graph.\n";
+        return false;
+    }
+    if ((spec.hardware == "ring" and spec.hNodes < 2) or
+        (spec.hardware == "poets" and
+         (spec.boxes == 0 or spec.cores == 0 or
+          spec.boards[0] * spec.boards[1] == 0 or
+          spec.mailboxes[0] * spec.mailboxes[1] == 0)))
+    {
+        errors << "Generator spec has a bad size for its hardware graph.\n";
+        return false;
+    }
+    return true;
+}
+
+/* Names nodes with a prefix and a zero-padded number, so that names sort in
+ * index order. */
+static std::string padded(std::string_view prefix, std::size_t value,
+                          std::size_t width)
+{
+    auto digits = std::to_string(value);
+    std::string out(prefix);
+    out.append(width - std::min(width, digits.size()), '0');
+    return out + digits;
+}
+
+/* Application nodes in a square grid, row by row, positioned by row (outer)
+ * and column (inner). */
+static void generate_grid(Problem& problem, std::size_t diameter,
+                          bool toroidal, unsigned numThreads)
+{
+    auto& nodeAs = problem.nodeAs;
+    nodeAs.resize(diameter * diameter);
+    auto width = std::to_string(diameter).size();
+    construct_in_parallel(diameter, numThreads,
+        [&](std::size_t first, std::size_t last)
+        {
+            for (auto outer = first; outer < last; outer++)
+            {
+                auto prefix = padded("A_", outer, width) + "_";
+                for (decltype(outer) inner = 0; inner < diameter; inner++)
+                    nodeAs[outer * diameter + inner] =
+                        std::make_shared<NodeA>(
+                            padded(prefix, inner, width),
+                            static_cast<float>(outer),
+                            static_cast<float>(inner));
+            }
+        });
+
+    construct_in_parallel(diameter, numThreads,
+        [&](std::size_t first, std::size_t last)
+        {
+            auto wrap = [&](std::size_t position, int step)
+            {
+                return (position + diameter + step) % diameter;
+            };
+            for (auto outer = first; outer < last; outer++)
+            for (decltype(outer) inner = 0; inner < diameter; inner++)
+            {
+                auto& neighbours = nodeAs[outer * diameter + inner]->
+                    neighbours;
+                neighbours.reserve(4);
+                if (toroidal or outer > 0)
+                    neighbours.emplace_back(
+                        nodeAs[wrap(outer, -1) * diameter + inner]);
+                if (toroidal or inner > 0)
+                    neighbours.emplace_back(
+                        nodeAs[outer * diameter + wrap(inner, -1)]);
+                if (toroidal or inner < diameter - 1)
+                    neighbours.emplace_back(
+                        nodeAs[outer * diameter + wrap(inner, 1)]);
+                if (toroidal or outer < diameter - 1)
+                    neighbours.emplace_back(
+                        nodeAs[wrap(outer, 1) * diameter + inner]);
+            }
+        });
+}
+
+/* Application nodes in a random geometric graph. Points are scattered over a
+ * square of unit density, so the radius for a given mean degree does not
+ * depend on the number of nodes, and are then ordered by the cell of a grid
+ * (with cells as wide as the radius) they fall in, so that neighbours need
+ * only be looked for in neighbouring cells. */
+static void generate_geometric(Problem& problem, std::size_t size,
+                               float degree, Seed seed, unsigned numThreads)
+{
+    double side = std::sqrt(static_cast<double>(size));
+    double radius = std::sqrt(degree / std::numbers::pi);
+    auto cellsAcross = std::max<std::size_t>(
+        1, static_cast<std::size_t>(side / radius));
+    double cellWidth = side / cellsAcross;
+
+    /* Scatter, in fixed-size chunks with a generator each, so that the graph
+     * depends on the seed but not on the number of threads. */
+    constexpr std::size_t chunkSize = 1 << 16;
+    std::vector<float> horiz(size);
+    std::vector<float> verti(size);
+    construct_in_parallel((size + chunkSize - 1) / chunkSize, numThreads,
+        [&](std::size_t first, std::size_t last)
+        {
+            std::uniform_real_distribution<float> distribution(
+                0, static_cast<float>(side));
+            for (auto chunk = first; chunk < last; chunk++)
+            {
+                std::seed_seq sequence{seed, static_cast<Seed>(chunk)};
+                Prng rng(sequence);
+                auto end = std::min(size, (chunk + 1) * chunkSize);
+                for (auto point = chunk * chunkSize; point < end; point++)
+                {
+                    horiz[point] = distribution(rng);
+                    verti[point] = distribution(rng);
+                }
+            }
+        });
+
+    /* Counting sort of points by cell. */
+    auto cellOf = [&](float posHoriz, float posVerti)
+    {
+        auto along = [&](float position)
+        {
+            return std::min(cellsAcross - 1,
+                            static_cast<std::size_t>(position / cellWidth));
+        };
+        return along(posHoriz) * cellsAcross + along(posVerti);
+    };
+    std::vector<unsigned> cellStarts(cellsAcross * cellsAcross + 1, 0);
+    for (std::size_t point = 0; point < size; point++)
+        cellStarts[cellOf(horiz[point], verti[point]) + 1]++;
+    for (std::size_t cell = 1; cell < cellStarts.size(); cell++)
+        cellStarts[cell] += cellStarts[cell - 1];
+    {
+        auto next = cellStarts;
+        std::vector<float> sortedHoriz(size);
+        std::vector<float> sortedVerti(size);
+        for (std::size_t point = 0; point < size; point++)
+        {
+            auto aIndex = next[cellOf(horiz[point], verti[point])]++;
+            sortedHoriz[aIndex] = horiz[point];
+            sortedVerti[aIndex] = verti[point];
+        }
+        horiz.swap(sortedHoriz);
+        verti.swap(sortedVerti);
+    }
+
+    auto& nodeAs = problem.nodeAs;
+    nodeAs.resize(size);
+    auto width = std::to_string(size).size();
+    construct_in_parallel(size, numThreads,
+        [&](std::size_t first, std::size_t last)
+        {
+            for (auto aIndex = first; aIndex < last; aIndex++)
+                nodeAs[aIndex] = std::make_shared<NodeA>(
+                    padded("A_", aIndex, width), horiz[aIndex],
+                    verti[aIndex]);
+        });
+
+    auto radiusSquared = static_cast<float>(radius * radius);
+    construct_in_parallel(size, numThreads,
+        [&](std::size_t first, std::size_t last)
+        {
+            std::vector<std::size_t> found;
+            for (auto aIndex = first; aIndex < last; aIndex++)
+            {
+                found.clear();
+                auto cell = cellOf(horiz[aIndex], verti[aIndex]);
+                auto cellHoriz = cell / cellsAcross;
+                auto cellVerti = cell % cellsAcross;
+                for (auto nHoriz = cellHoriz - std::min<std::size_t>(
+                         cellHoriz, 1);
+                     nHoriz <= std::min(cellHoriz + 1, cellsAcross - 1);
+                     nHoriz++)
+                for (auto nVerti = cellVerti - std::min<std::size_t>(
+                         cellVerti, 1);
+                     nVerti <= std::min(cellVerti + 1, cellsAcross - 1);
+                     nVerti++)
+                {
+                    auto nCell = nHoriz * cellsAcross + nVerti;
+                    for (std::size_t nIndex = cellStarts[nCell];
+                         nIndex < cellStarts[nCell + 1]; nIndex++)
+                    {
+                        auto dHoriz = horiz[nIndex] - horiz[aIndex];
+                        auto dVerti = verti[nIndex] - verti[aIndex];
+                        if (nIndex != aIndex and dHoriz * dHoriz +
+                            dVerti * dVerti <= radiusSquared)
+                            found.push_back(nIndex);
+                    }
+                }
+
+                auto& neighbours = nodeAs[aIndex]->neighbours;
+                neighbours.reserve(found.size());
+                for (const auto& nIndex : found)
+                    neighbours.emplace_back(nodeAs[nIndex]);
+            }
+        });
+}
+
+/* Hardware nodes in a ring, positioned on a circle. */
+static void generate_ring(Problem& problem, unsigned size, float weight)
+{
+    auto width = std::to_string(size).size();
+    auto radius = size / (2 * std::numbers::pi);
+    for (unsigned hIndex = 0; hIndex < size; hIndex++)
+    {
+        auto angle = 2 * std::numbers::pi * hIndex / size;
+        problem.nodeHs.push_back(std::make_shared<NodeH>(
+            padded("H_", hIndex, width), hIndex,
+            static_cast<float>(radius * std::cos(angle)),
+            static_cast<float>(radius * std::sin(angle))));
+        problem.edgeHs.emplace_back(hIndex, (hIndex + 1) % size, weight);
+    }
+}
+
+/* Hardware nodes as the cores of a row of POETS boxes. Mailboxes across all
+ * boxes form one grid (boxes and boards abut along the outer direction), in
+ * which each mailbox is connected to its neighbours, with the weight of the
+ * outermost boundary crossed. Cores are laid out in a square (best efforts)
+ * in their mailbox. Hardware nodes are indexed box by box, board by board,
+ * then mailbox by mailbox. */
+static void generate_poets(Problem& problem, const GeneratorSpec& spec)
+{
+    auto [boardsOuter, boardsInner] = spec.boards;
+    auto [mboxesOuter, mboxesInner] = spec.mailboxes;
+    auto cores = spec.cores;
+    auto coresAcross = static_cast<unsigned>(std::ceil(std::sqrt(cores)));
+    auto [coreWeight, mboxWeight, boardWeight, boxWeight] = spec.weights;
+    unsigned mboxesAcrossOuter = spec.boxes * boardsOuter * mboxesOuter;
+    unsigned mboxesAcrossInner = boardsInner * mboxesInner;
+
+    /* Index of a hardware node, given the position of its mailbox in the
+     * grid of all mailboxes. */
+    auto hIndexGivenPos = [&](unsigned outer, unsigned inner, unsigned core)
+    {
+        auto board = (outer / mboxesOuter) * boardsInner +
+            inner / mboxesInner;
+        auto mbox = (outer % mboxesOuter) * mboxesInner +
+            inner % mboxesInner;
+        return (board * mboxesOuter * mboxesInner + mbox) * cores + core;
+    };
+
+    problem.nodeHs.resize(mboxesAcrossOuter * mboxesAcrossInner * cores);
+    for (unsigned outer = 0; outer < mboxesAcrossOuter; outer++)
+    for (unsigned inner = 0; inner < mboxesAcrossInner; inner++)
+    for (unsigned core = 0; core < cores; core++)
+    {
+        unsigned boardOuter = outer / mboxesOuter;
+        std::vector<unsigned> address = {
+            (boardOuter % boardsOuter) * boardsInner + inner / mboxesInner,
+            (outer % mboxesOuter) * mboxesInner + inner % mboxesInner,
+            core};
+        std::stringstream name;
+        name << "H";
+        if (spec.boxes > 1)
+        {
+            address.insert(address.begin(), boardOuter / boardsOuter);
+            name << "_" << boardOuter / boardsOuter;
+        }
+        name << "_" << boardOuter % boardsOuter
+             << "_" << inner / mboxesInner
+             << "_" << outer % mboxesOuter
+             << "_" << inner % mboxesInner
+             << "_" << core;
+
+        auto hIndex = hIndexGivenPos(outer, inner, core);
+        auto& nodeH = problem.nodeHs[hIndex] = std::make_shared<NodeH>(
+            name.str(), hIndex,
+            static_cast<float>(outer * coresAcross + core % coresAcross),
+            static_cast<float>(inner * coresAcross + core / coresAcross));
+        nodeH->address = std::move(address);
+
+        /* Edges to later cores in this mailbox. */
+        for (auto nCore = core + 1; nCore < cores; nCore++)
+            problem.edgeHs.emplace_back(
+                hIndex, hIndexGivenPos(outer, inner, nCore), coreWeight);
+
+        /* Edges to every core in the next mailbox in each direction. */
+        if (outer + 1 < mboxesAcrossOuter)
+        {
+            auto nOuter = outer + 1;
+            auto weight = nOuter % mboxesOuter != 0 ? mboxWeight :
+                nOuter % (boardsOuter * mboxesOuter) != 0 ? boardWeight :
+                boxWeight;
+            for (unsigned nCore = 0; nCore < cores; nCore++)
+                problem.edgeHs.emplace_back(
+                    hIndex, hIndexGivenPos(nOuter, inner, nCore), weight);
+        }
+        if (inner + 1 < mboxesAcrossInner)
+        {
+            auto nInner = inner + 1;
+            auto weight = nInner % mboxesInner != 0 ? mboxWeight :
+                boardWeight;
+            for (unsigned nCore = 0; nCore < cores; nCore++)
+                problem.edgeHs.emplace_back(
+                    hIndex, hIndexGivenPos(outer, nInner, nCore), weight);
+        }
+    }
+}
+
+/* Defines this problem from a generator spec (see the top of this file).
+ * Returns false (having written to `errors`) if the spec is malformed, or if
+ * the hardware cannot hold the application. */
+bool Problem::generate_problem(const std::string_view& specText,
+                               std::stringstream& errors,
+                               unsigned numThreads)
+{
+    GeneratorSpec spec;
+    if (!parse_spec(specText, spec, errors)) return false;
+
+    /* Check that the hardware can hold the application before generating
+     * either. */
+    bool geometric = spec.application == "geometric";
+    bool ring = spec.hardware == "ring";
+    unsigned long long numAs = geometric ? spec.nodes :
+        spec.diameter * spec.diameter;
+    unsigned long long numHs = ring ? spec.hNodes :
+        1ull * spec.boxes * spec.boards[0] * spec.boards[1] *
+        spec.mailboxes[0] * spec.mailboxes[1] * spec.cores;
+    unsigned long long specPMax = spec.pMax;
+    if (specPMax == 0) specPMax = ring ? 2 * ((numAs + numHs - 1) / numHs) :
+        16 * 256;
+    if (specPMax * numHs < numAs)
+    {
+        errors << "Generator spec has " << numAs << " application nodes, "
+               << "which is more than its " << numHs << " hardware nodes "
+               << "can hold with a pmax of " << specPMax << ".\n";
+        return false;
+    }
+
+    nodeAs.clear();
+    nodeHs.clear();
+    edgeHs.clear();
+    edgeCacheH.clear();
+    edgeCacheExact.clear();
+    pMax = static_cast<unsigned>(specPMax);
+
+    std::stringstream defaultName;
+    defaultName << spec.application << "_";
+    if (geometric)
+    {
+        defaultName << spec.nodes;
+        generate_geometric(*this, spec.nodes, spec.degree, spec.seed,
+                           numThreads);
+    }
+    else
+    {
+        defaultName << spec.diameter;
+        generate_grid(*this, spec.diameter, spec.application == "torus",
+                      numThreads);
+    }
+
+    defaultName << "_" << spec.hardware << "_";
+    if (ring)
+    {
+        defaultName << spec.hNodes;
+        generate_ring(*this, spec.hNodes, spec.weight);
+    }
+    else
+    {
+        defaultName << spec.boxes << "x" << spec.boards[0] << "x"
+                    << spec.boards[1] << "x" << spec.mailboxes[0] << "x"
+                    << spec.mailboxes[1] << "x" << spec.cores;
+        generate_poets(*this, spec);
+    }
+
+    name = spec.name.empty() ? defaultName.str() : std::string(spec.name);
+    return true;
+}
@@ -0,0 +1,204 @@
+/* Methods defined in this TU support annealing in stages that follow the
+ * hierarchy of the hardware graph (see nodes.hpp for hardware addresses, and
+ * staged_annealer.cpp for the stages themselves). The central idea is that of
+ * a coarse problem: a problem whose hardware nodes are groups of hardware
+ * nodes from this problem, and whose application nodes are a subset of the
+ * application nodes from this problem. */
+
+#include "problem.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <unordered_map>
+
+/* Returns the number of levels in the hardware hierarchy, or zero if the
+ * hardware nodes do not all have addresses of the same length. */
+unsigned Problem::compute_h_hierarchy_depth()
+{
+    if (nodeHs.empty()) return 0;
+    auto depth = nodeHs.front()->address.size();
+    for (const auto& nodeH : nodeHs)
+        if (nodeH->address.size() != depth) return 0;
+    return static_cast<unsigned>(depth);
+}
+
+/* Defines a coarse problem in `coarse` (which must be freshly constructed and
+ * seeded), where:
+ *
+ * - Each hardware node of the coarse problem represents a group of hardware
+ *   nodes of this problem (by index in `hGroups`). The distance between two
+ *   coarse hardware nodes is the mean distance between their members (scaled,
+ *   see below), and their position is the mean position of their members. Requires the edge
+ *   cache of this problem to be populated, and populates the edge cache of
+ *   the coarse problem.
+ *
+ * - Each application node of the coarse problem is a copy of an application
+ *   node of this problem (by index in `aIndices`). Only neighbours within
+ *   `aIndices` are retained.
+ *
+ * - The capacity of a group is pMax for each of its available members, and
+ *   groups with no available members are unavailable. The coarse pMax is the
+ *   capacity of the smallest available group, so that the coarse anneal never
+ *   moves more application nodes into a group than it can hold. Larger
+ *   groups only use their extra capacity in the initial condition (the
+ *   anneal moves nothing into a group at or over the coarse pMax).
+ *
+ * The coarse problem also receives an initial condition, inherited from this
+ * problem where an application node is currently placed on a member of a
+ * group (and that group has room), and random otherwise, filling each group
+ * up to its capacity. Aborts if the groups can't hold the application nodes
+ * between them. */
+void Problem::define_coarse_problem(
+    Problem& coarse, const std::vector<unsigned>& aIndices,
+    const std::vector<std::vector<unsigned>>& hGroups)
+{
+    coarse.name = name;
+
+    /* Capacity */
+    std::vector<unsigned long long> capacities;
+    capacities.reserve(hGroups.size());
+    unsigned long long smallestCapacity =
+        std::numeric_limits<unsigned>::max();
+    for (const auto& group : hGroups)
+    {
+        auto members = std::count_if(
+            group.begin(), group.end(),
+            [this](unsigned hIndex){return nodeHs[hIndex]->available;});
+        auto capacity = static_cast<unsigned long long>(pMax) *
+            static_cast<unsigned long long>(members);
+        capacities.push_back(capacity);
+        if (capacity > 0)
+            smallestCapacity = std::min(smallestCapacity, capacity);
+    }
+    coarse.pMax = static_cast<unsigned>(smallestCapacity);
+
+    /* Hardware nodes, and a lookup from our hardware nodes to them. */
+    std::vector<long long> groupGivenH(nodeHs.size(), -1);
+    coarse.nodeHs.reserve(hGroups.size());
+    for (decltype(nodeHs)::size_type groupIndex = 0;
+         groupIndex < hGroups.size(); groupIndex++)
+    {
+        float posHoriz = 0;
+        float posVerti = 0;
+        for (const auto& hIndex : hGroups[groupIndex])
+        {
+            groupGivenH[hIndex] = static_cast<long long>(groupIndex);
+            posHoriz += nodeHs[hIndex]->posHoriz;
+            posVerti += nodeHs[hIndex]->posVerti;
+        }
+        auto groupSize = static_cast<float>(hGroups[groupIndex].size());
+        coarse.nodeHs.push_back(std::make_shared<NodeH>(
+            nodeHs[hGroups[groupIndex].front()]->name,
+            static_cast<unsigned>(groupIndex),
+            posHoriz / groupSize, posVerti / groupSize));
+        coarse.nodeHs.back()->available = capacities[groupIndex] > 0;
+    }
+
+    /* Hardware edges - the coarse graph is complete, so there is no need to
+     * run Floyd-Warshall over it. A group of `k` hardware nodes holding `n`
+     * application nodes evenly has a clustering fitness of `-n^2 / k`, but
+     * the coarse problem computes it as `-n^2`, so distances are scaled by
+     * the mean group size to keep the balance between clustering and
+     * locality the same as in this problem. */
+    double scale = 0;
+    for (const auto& group : hGroups) scale += group.size();
+    scale /= static_cast<double>(hGroups.size());
+    for (decltype(nodeHs)::size_type first = 0; first < hGroups.size();
+         first++)
+    {
+        for (auto second = first + 1; second < hGroups.size(); second++)
+        {
+            double total = 0;
+            for (const auto& firstH : hGroups[first])
+                for (const auto& secondH : hGroups[second])
+                    total += edgeCacheH[firstH][secondH];
+            total *= scale / static_cast<double>(hGroups[first].size() *
+                                                 hGroups[second].size());
+            coarse.edgeHs.push_back(std::tuple(
+                static_cast<unsigned>(first), static_cast<unsigned>(second),
+                static_cast<float>(total)));
+        }
+    }
+
+    /* Application nodes, and their neighbours (if they're also in the coarse
+     * problem). */
+    std::unordered_map<const NodeA*, unsigned> coarseIndexGivenPtr;
+    coarseIndexGivenPtr.reserve(aIndices.size());
+    coarse.nodeAs.reserve(aIndices.size());
+    for (const auto& aIndex : aIndices)
+    {
+        const auto& nodeA = nodeAs[aIndex];
+        coarseIndexGivenPtr[nodeA.get()] =
+            static_cast<unsigned>(coarse.nodeAs.size());
+        coarse.nodeAs.push_back(std::make_shared<NodeA>(
+            nodeA->name, nodeA->posHoriz, nodeA->posVerti));
+    }
+
+    for (decltype(nodeAs)::size_type coarseIndex = 0;
+         coarseIndex < aIndices.size(); coarseIndex++)
+    {
+        for (const auto& neighbourPtr : nodeAs[aIndices[coarseIndex]]->
+                 neighbours)
+        {
+            auto found = coarseIndexGivenPtr.find(neighbourPtr.lock().get());
+            if (found == coarseIndexGivenPtr.end()) continue;
+            coarse.nodeAs[coarseIndex]->neighbours.push_back(
+                coarse.nodeAs[found->second]);
+        }
+    }
+
+    /* The edge cache, once the application graph is defined (see
+     * quantise_edge_cache). */
+    coarse.initialise_edge_cache(static_cast<unsigned>(hGroups.size()));
+
+    /* Initial condition - inherit where we can. */
+    std::vector<unsigned> toPlace;
+    for (decltype(nodeAs)::size_type coarseIndex = 0;
+         coarseIndex < aIndices.size(); coarseIndex++)
+    {
+        auto location = nodeAs[aIndices[coarseIndex]]->location.lock();
+        if (location and groupGivenH[location->index] >= 0)
+        {
+            const auto& coarseH = coarse.nodeHs[
+                static_cast<unsigned>(groupGivenH[location->index])];
+            if (coarseH->contents.size() < capacities[coarseH->index])
+            {
+                const auto& coarseA = coarse.nodeAs[coarseIndex];
+                coarseA->location = std::weak_ptr(coarseH);
+                coarseH->contents.insert(coarseA.get());
+                continue;
+            }
+        }
+        toPlace.push_back(static_cast<unsigned>(coarseIndex));
+    }
+
+    /* ...and place the rest at random (as with initial_condition_random). */
+    std::vector<unsigned> nonFull;
+    for (const auto& coarseH : coarse.nodeHs)
+        if (coarseH->contents.size() < capacities[coarseH->index])
+            nonFull.push_back(coarseH->index);
+    for (const auto& coarseIndex : toPlace)
+    {
+        if (nonFull.empty())
+        {
+            auto message = "Hardware groups can't hold their application "
+                "nodes while defining a coarse problem. Aborting.";
+            log(message);
+            std::cerr << message << std::endl;
+            std::abort();
+        }
+        std::uniform_int_distribution<decltype(nonFull)::size_type>
+            distribution(0, nonFull.size() - 1);
+        auto roll = distribution(coarse.rng);
+        const auto& coarseA = coarse.nodeAs[coarseIndex];
+        const auto& coarseH = coarse.nodeHs[nonFull[roll]];
+        coarseA->location = std::weak_ptr(coarseH);
+        coarseH->contents.insert(coarseA.get());
+        if (coarseH->contents.size() >= capacities[coarseH->index])
+        {
+            nonFull[roll] = nonFull.back();
+            nonFull.pop_back();
+        }
+    }
+}
@@ -0,0 +1,356 @@
+/* Methods defined in this TU change a placed problem incrementally, without
+ * rebuilding it. Changes to the application graph return the change in total
+ * fitness they cause (see compute_total_fitness), so that a caller can track
+ * the fitness without recomputing it. Hardware nodes can be taken out of
+ * service (see disable_h_node), which evacuates them.
+ *
+ * Once the problem has changed, the affected region of the placement can be
+ * re-annealed locally, by restricting selection to the neighbourhood of the
+ * nodes that changed (or were evacuated) and running a short anneal, e.g.:
+ *
+ *     problem.restrict_selection(problem.compute_neighbourhood(changed, 2));
+ *     SerialAnnealer<ExpDecayDisorder>(iterations)(problem);
+ *     problem.restrict_selection({});
+ *
+ * Local means local in effect, not entirely in cost. Changes themselves, the
+ * search in compute_neighbourhood, and the iterations of the anneal only
+ * touch the region, but some steps still pass over the whole problem:
+ *
+ * - compute_neighbourhood resolves the indices it found with a pass over the
+ *   application nodes.
+ *
+ * - The annealer computes the total fitness before it starts (a pass over the
+ *   application graph). It builds no fixed-degree view while selection is
+ *   restricted (see Annealer::begin_fixed_degree).
+ *
+ * - disable_h_node finds the evacuees with a pass over the application nodes,
+ *   and runs Dijkstra's algorithm from each affected hardware node.
+ *
+ * For a million application nodes, this puts a local re-anneal in the
+ * hundreds of milliseconds, mostly spent computing the total fitness.
+ *
+ * None of these methods are thread safe - don't call them while annealing. */
+
+#include "problem.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <unordered_set>
+
+/* Adds an application node to the problem, and places it greedily (see
+ * place_greedily). The node must not have a location or neighbours - connect
+ * it with add_app_edge once it has been added. It takes the index
+ * nodeAs.size() - 1. */
+float Problem::add_app_node(const std::shared_ptr<NodeA>& nodeA)
+{
+    nodeAs.push_back(nodeA);
+    place_greedily(nodeAs.size() - 1);
+
+    /* Clustering fitness changes from -c^2 to -(c + 1)^2 on the hardware node
+     * that now holds it. */
+    auto loading = static_cast<float>(nodeA->location.lock()->contents.size());
+    return -(2 * loading - 1);
+}
+
+/* Connects two application nodes by index. Does nothing if they are connected
+ * already (edges are not weighted, so there is no meaning to a multi-edge). */
+float Problem::add_app_edge(decltype(nodeAs)::size_type first,
+                            decltype(nodeAs)::size_type second)
+{
+    const auto& nodeA = nodeAs.at(first);
+    const auto& neighbourA = nodeAs.at(second);
+    for (const auto& neighbourPtr : nodeA->neighbours)
+        if (neighbourPtr.lock() == neighbourA) return 0;
+
+    nodeA->neighbours.push_back(std::weak_ptr(neighbourA));
+    neighbourA->neighbours.push_back(std::weak_ptr(nodeA));
+
+    /* Recall that edges are double-counted. */
+    return -2 * edgeCacheH[nodeA->location.lock()->index]
+        [neighbourA->location.lock()->index];
+}
+
+/* Disconnects two application nodes by index. Does nothing if they are not
+ * connected. */
+float Problem::remove_app_edge(decltype(nodeAs)::size_type first,
+                               decltype(nodeAs)::size_type second)
+{
+    const auto& nodeA = nodeAs.at(first);
+    const auto& neighbourA = nodeAs.at(second);
+
+    auto removeNeighbour = [](NodeA& from, const std::shared_ptr<NodeA>& to)
+    {
+        auto found = std::find_if(
+            from.neighbours.begin(), from.neighbours.end(),
+            [&to](const auto& neighbourPtr)
+            {return neighbourPtr.lock() == to;});
+        if (found == from.neighbours.end()) return false;
+        *found = from.neighbours.back();  /* Order is irrelevant. */
+        from.neighbours.pop_back();
+        return true;
+    };
+
+    if (!removeNeighbour(*nodeA, neighbourA)) return 0;
+    removeNeighbour(*neighbourA, nodeA);
+
+    return 2 * edgeCacheH[nodeA->location.lock()->index]
+        [neighbourA->location.lock()->index];
+}
+
+/* Removes an application node by index, along with its edges. To keep indices
+ * dense, the last application node takes the index of the removed one - all
+ * other indices are unchanged. Any restriction on selection is lifted, because
+ * the indices it holds may no longer be valid. */
+float Problem::remove_app_node(decltype(nodeAs)::size_type aIndex)
+{
+    auto nodeA = nodeAs.at(aIndex);  /* Keep it alive until we're done. */
+    float delta = 0;
+
+    /* Edges. Each neighbour loses its edge to this node, and the edge's
+     * contribution goes with it (if both ends are placed). */
+    auto rootH = nodeA->location.lock();
+    for (const auto& neighbourPtr : nodeA->neighbours)
+    {
+        auto neighbourA = neighbourPtr.lock();
+        if (!neighbourA) continue;
+        auto& backEdges = neighbourA->neighbours;
+        backEdges.erase(std::remove_if(
+            backEdges.begin(), backEdges.end(),
+            [&nodeA](const auto& backPtr){return backPtr.lock() == nodeA;}),
+            backEdges.end());
+        auto neighbourH = neighbourA->location.lock();
+        if (rootH and neighbourH)
+            delta += 2 * edgeCacheH[rootH->index][neighbourH->index];
+    }
+    nodeA->neighbours.clear();
+
+    /* Occupancy. Clustering fitness changes from -c^2 to -(c - 1)^2. */
+    if (rootH)
+    {
+        auto loading = static_cast<float>(rootH->contents.size());
+        delta += 2 * loading - 1;
+        rootH->contents.erase(nodeA.get());
+        nodeA->location.reset();
+    }
+
+    /* Index maintenance. */
+    nodeAs[aIndex] = nodeAs.back();
+    nodeAs.pop_back();
+
+    if (!selectableAs.empty())
+    {
+        selectableAs.clear();
+        log("Selection restriction lifted on removal of an application node.");
+    }
+
+    return delta;
+}
+
+/* Returns the indices of the application nodes within `hops` edges of any of
+ * the application nodes in `aIndices` (inclusive, sorted). The search itself
+ * only visits the neighbourhood, but resolving indices requires a pass over
+ * the application nodes. */
+std::vector<unsigned> Problem::compute_neighbourhood(
+    const std::vector<unsigned>& aIndices, unsigned hops)
+{
+    /* Breadth-first, one hop at a time. */
+    std::unordered_set<NodeA*> visited;
+    std::vector<NodeA*> frontier;
+    for (const auto& aIndex : aIndices)
+    {
+        auto nodeA = nodeAs.at(aIndex).get();
+        if (visited.insert(nodeA).second) frontier.push_back(nodeA);
+    }
+
+    for (unsigned hop = 0; hop < hops and !frontier.empty(); hop++)
+    {
+        std::vector<NodeA*> nextFrontier;
+        for (const auto& nodeA : frontier)
+            for (const auto& neighbourPtr : nodeA->neighbours)
+            {
+                auto neighbourA = neighbourPtr.lock().get();
+                if (neighbourA and visited.insert(neighbourA).second)
+                    nextFrontier.push_back(neighbourA);
+            }
+        frontier = std::move(nextFrontier);
+    }
+
+    std::vector<unsigned> output;
+    output.reserve(visited.size());
+    for (decltype(nodeAs)::size_type aIndex = 0; aIndex < nodeAs.size();
+         aIndex++)
+        if (visited.contains(nodeAs[aIndex].get()))
+            output.push_back(static_cast<unsigned>(aIndex));
+    return output;
+}
+
+/* Restricts selection of application nodes to those in `aIndices` (see
+ * roll_sela), for re-annealing a region of the placement. Lifts the
+ * restriction if `aIndices` is empty. */
+void Problem::restrict_selection(const std::vector<unsigned>& aIndices)
+{
+    for (const auto& aIndex : aIndices) nodeAs.at(aIndex);  /* Bounds check. */
+    selectableAs = aIndices;
+
+    std::stringstream message;
+    if (selectableAs.empty()) message << "Selection restriction lifted.";
+    else message << "Selection restricted to " << selectableAs.size()
+                 << " application node(s).";
+    log(message.str());
+}
+
+/* Takes the hardware node at `hIndex` out of service. Updates the edge cache
+ * so that no path passes through it (see update_edge_cache_without), then
+ * evacuates its application nodes, placing each greedily (see
+ * place_greedily). Writes the indices of the evacuated application nodes to
+ * `evacuated`, in ascending order, for local re-annealing.
+ *
+ * This is for use on a problem that has already been placed. Returns false,
+ * having changed nothing, if the rest of the available hardware does not
+ * have room for the evacuees. */
+bool Problem::disable_h_node(unsigned hIndex, std::vector<unsigned>& evacuated)
+{
+    const auto& nodeH = nodeHs.at(hIndex);
+    evacuated.clear();
+    if (!nodeH->available) return true;
+
+    /* Is there room elsewhere? */
+    unsigned long long spare = 0;
+    for (const auto& otherH : nodeHs)
+        if (otherH != nodeH and otherH->available and
+            otherH->contents.size() < pMax)
+            spare += pMax - otherH->contents.size();
+
+    std::stringstream message;
+    if (spare < nodeH->contents.size())
+    {
+        message << "Cannot disable hardware node '" << nodeH->name
+                << "' - the rest of the hardware has room for " << spare
+                << " of its " << nodeH->contents.size()
+                << " application node(s).";
+        log(message.str());
+        return false;
+    }
+
+    message << "Disabling hardware node '" << nodeH->name << "'.";
+    log(message.str());
+
+    nodeH->available = false;
+    update_edge_cache_without(hIndex);
+
+    /* Evacuate everyone before placing anyone, so that evacuees don't try to
+     * follow each other. */
+    for (decltype(nodeAs)::size_type aIndex = 0; aIndex < nodeAs.size();
+         aIndex++)
+    {
+        if (!nodeH->contents.contains(nodeAs[aIndex].get())) continue;
+        nodeAs[aIndex]->location.reset();
+        evacuated.push_back(static_cast<unsigned>(aIndex));
+    }
+    nodeH->contents.clear();
+    LoadOrder loadOrder;
+    build_load_order(loadOrder);
+    for (const auto& aIndex : evacuated) place_greedily(aIndex, loadOrder);
+
+    message.str("");
+    message << "Hardware node '" << nodeH->name << "' disabled ("
+            << evacuated.size() << " application node(s) evacuated).";
+    log(message.str());
+    return true;
+}
+
+/* Updates the edge cache to remove the hardware node at `hIndex` from the
+ * hardware graph, as an alternative to repopulating it from scratch. Only
+ * rows from which a shortest path passes through that node can change - those
+ * rows are recomputed using Dijkstra's algorithm over the available hardware
+ * nodes (and mirrored to keep the cache symmetric). Distances to and from the
+ * removed node become infinite. Only those rows (and their columns) are
+ * re-quantised. Requires the edge cache to be populated. */
+void Problem::update_edge_cache_without(unsigned hIndex)
+{
+    const auto size = edgeCacheH.size();
+    constexpr auto infinity = std::numeric_limits<float>::max();
+
+    /* Which rows are affected? A row is affected if the removed node sits on
+     * a shortest path from it (with some slack for rounding), in which case
+     * an equally short path may or may not exist without it. */
+    const auto& removedRow = edgeCacheH[hIndex];
+    std::vector<unsigned> affected;
+    for (decltype(edgeCacheH)::size_type source = 0; source < size; source++)
+    {
+        if (source == hIndex or removedRow[source] == infinity) continue;
+        const auto& row = edgeCacheH[source];
+        for (decltype(edgeCacheH)::size_type target = 0; target < size;
+             target++)
+        {
+            if (target == hIndex or target == source or
+                removedRow[target] == infinity) continue;
+            if (removedRow[source] + removedRow[target] <=
+                row[target] * (1 + 1e-6f))
+            {
+                affected.push_back(static_cast<unsigned>(source));
+                break;
+            }
+        }
+    }
+
+    std::stringstream message;
+    message << "Updating edge cache without hardware node " << hIndex << " ("
+            << affected.size() << " of " << size << " row(s) affected).";
+    log(message.str());
+
+    /* Adjacency over available hardware nodes. */
+    std::vector<std::vector<std::pair<unsigned, float>>> adjacency(size);
+    for (const auto& edge : edgeHs)
+    {
+        auto first = std::get<0>(edge);
+        auto second = std::get<1>(edge);
+        if (!nodeHs[first]->available or !nodeHs[second]->available) continue;
+        adjacency[first].emplace_back(second, std::get<2>(edge));
+        adjacency[second].emplace_back(first, std::get<2>(edge));
+    }
+
+    /* Dijkstra from each affected row. */
+    typedef std::pair<float, unsigned> Entry;
+    std::vector<float> distances;
+    for (const auto& source : affected)
+    {
+        distances.assign(size, infinity);
+        distances[source] = 0;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>>
+            frontier;
+        frontier.emplace(0, source);
+        while (!frontier.empty())
+        {
+            auto [distance, current] = frontier.top();
+            frontier.pop();
+            if (distance > distances[current]) continue;
+            for (const auto& [next, weight] : adjacency[current])
+            {
+                if (distance + weight >= distances[next]) continue;
+                distances[next] = distance + weight;
+                frontier.emplace(distances[next], next);
+            }
+        }
+
+        for (decltype(edgeCacheH)::size_type target = 0; target < size;
+             target++)
+        {
+            edgeCacheH[source][target] = distances[target];
+            edgeCacheH[target][source] = distances[target];
+        }
+    }
+
+    /* The removed node itself. */
+    for (decltype(edgeCacheH)::size_type other = 0; other < size; other++)
+    {
+        if (other == hIndex) continue;
+        edgeCacheH[hIndex][other] = infinity;
+        edgeCacheH[other][hIndex] = infinity;
+    }
+    affected.push_back(hIndex);
+    quantise_edge_cache(affected);
+
+    log("Edge cache updated.");
+}
@@ -0,0 +1,239 @@
+/* Methods defined in this TU construct an initial condition by recursive
+ * bisection. The application graph and the hardware graph are bisected in
+ * lockstep, so that each half of the application graph is placed onto a half
+ * of the hardware graph, until each part of the application graph corresponds
+ * to exactly one hardware node. Specifically:
+ *
+ * - Application graph bisections are grown by breadth-first search from a
+ *   pseudo-peripheral node of the subgraph being bisected. For mesh-like
+ *   graphs, this keeps neighbours together and cuts few edges.
+ *
+ * - Hardware graph bisections order hardware nodes by their distance (from
+ *   the edge cache) to a pseudo-peripheral hardware node, and cut that
+ *   ordering in half.
+ *
+ * The number of application nodes in each part is proportional to the number
+ * of hardware nodes that part is destined for, and never exceeds what those
+ * hardware nodes can hold given pMax. Each bisection produces two independent
+ * subproblems, which are solved concurrently while threads are available. */
+
+#include "problem.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+/* Defines an initial state for the annealer by recursive bisection, by
+ * populating the location field in each application node, and the contents
+ * field in each hardware node. Only available hardware nodes are bisected
+ * (and so used). Uses up to `numThreads` threads. Requires the edge cache to
+ * be populated.
+ *
+ * Falls over violently if there are too many application nodes for the
+ * hardware graph to hold.
+ *
+ * This initialiser assumes that the aforementioned fields have not been
+ * defined. */
+void Problem::initial_condition_partition(unsigned numThreads)
+{
+    {
+        std::stringstream message;
+        message << "Applying recursive bisection initial condition with "
+                << numThreads << " thread(s).";
+        log(message.str());
+    }
+
+    /* Index-based view of the application graph, so that nodes can be
+     * labelled in flat arrays. */
+    std::vector<unsigned> aOffsets;
+    std::vector<unsigned> aTargets;
+    build_a_adjacency(aOffsets, aTargets);
+
+    /* Everything starts in the same (root) subset. */
+    std::vector<unsigned> aSubset(nodeAs.size());
+    std::iota(aSubset.begin(), aSubset.end(), 0);
+    std::vector<unsigned> hSubset;
+    list_available_h_nodes(hSubset);
+
+    /* Each application node is labelled with the identifier of the subset it
+     * currently belongs to. The root subset is zero, and the children of
+     * subset `s` are `2s + 1` and `2s + 2`. Labels are atomic because a thread
+     * reads the labels of neighbours that may belong to subsets being
+     * bisected by other threads (it never writes them). Stamps are used to
+     * mark visited nodes during the search for a pseudo-peripheral node, and
+     * are only ever touched by the thread that owns the node. */
+    std::vector<std::atomic<unsigned long long>> aLabels(nodeAs.size());
+    std::vector<unsigned long long> aStamps(nodeAs.size(), 0);
+
+    if (!hSubset.empty())
+        partition_bisect(0, aSubset, hSubset, aOffsets, aTargets, aLabels,
+                         aStamps, std::max(numThreads, 1u));
+
+    log("Initial condition applied.");
+}
+
+/* Bisects the application nodes in `aSubset` (all labelled `subsetId`) and the
+ * hardware nodes in `hSubset`, recursing until one hardware node remains, at
+ * which point the application nodes are placed on it. Both subset containers
+ * are consumed. */
+void Problem::partition_bisect(
+    unsigned long long subsetId,
+    std::vector<unsigned>& aSubset,
+    std::vector<unsigned>& hSubset,
+    const std::vector<unsigned>& aOffsets,
+    const std::vector<unsigned>& aTargets,
+    std::vector<std::atomic<unsigned long long>>& aLabels,
+    std::vector<unsigned long long>& aStamps,
+    unsigned numThreads)
+{
+    /* Place everything in this part on the only hardware node left. */
+    if (hSubset.size() == 1)
+    {
+        const auto& nodeH = nodeHs[hSubset.front()];
+        for (const auto& aIndex : aSubset)
+        {
+            nodeAs[aIndex]->location = std::weak_ptr(nodeH);
+            nodeH->contents.insert(nodeAs[aIndex].get());
+        }
+        return;
+    }
+
+    /* Bisect the hardware nodes. Find the node farthest from an arbitrary
+     * node in the subset, and order the subset by distance from that node
+     * (ties broken by index, which keeps cores in a mailbox together for the
+     * examples). */
+    const auto& arbitraryRow = edgeCacheH[hSubset.front()];
+    auto hPeripheral = *std::max_element(
+        hSubset.begin(), hSubset.end(),
+        [&arbitraryRow](unsigned first, unsigned second)
+        {return arbitraryRow[first] < arbitraryRow[second];});
+    const auto& peripheralRow = edgeCacheH[hPeripheral];
+    std::sort(hSubset.begin(), hSubset.end(),
+              [&peripheralRow](unsigned first, unsigned second)
+              {
+                  if (peripheralRow[first] != peripheralRow[second])
+                      return peripheralRow[first] < peripheralRow[second];
+                  return first < second;
+              });
+    auto hSplit = hSubset.begin() + static_cast<std::ptrdiff_t>(
+        hSubset.size() / 2);
+    std::vector<unsigned> hLeft(hSubset.begin(), hSplit);
+    std::vector<unsigned> hRight(hSplit, hSubset.end());
+
+    /* Number of application nodes in the left part - proportional to the
+     * number of hardware nodes, but no more than either side can hold. */
+    unsigned long long aSize = aSubset.size();
+    unsigned long long aLeftSize = (aSize * hLeft.size() +
+                                    hSubset.size() / 2) / hSubset.size();
+    unsigned long long leftCapacity = hLeft.size() *
+        static_cast<unsigned long long>(pMax);
+    unsigned long long rightCapacity = hRight.size() *
+        static_cast<unsigned long long>(pMax);
+    aLeftSize = std::min(aLeftSize, leftCapacity);
+    if (aSize > rightCapacity)
+        aLeftSize = std::max(aLeftSize, aSize - rightCapacity);
+
+    auto leftId = subsetId * 2 + 1;
+    auto rightId = subsetId * 2 + 2;
+    std::vector<unsigned> aLeft;
+    std::vector<unsigned> aRight;
+    aLeft.reserve(aLeftSize);
+    aRight.reserve(aSize - aLeftSize);
+
+    /* Breadth-first search queue, reused for both searches below. */
+    std::vector<unsigned> queue;
+    queue.reserve(aSize);
+    decltype(queue)::size_type queueHead;
+
+    if (aLeftSize > 0)
+    {
+        /* Find a pseudo-peripheral node - the last node reached by a
+         * breadth-first search (within this subset) from an arbitrary
+         * node. */
+        queue.push_back(aSubset.front());
+        aStamps[aSubset.front()] = subsetId + 1;
+        for (queueHead = 0; queueHead < queue.size(); queueHead++)
+        {
+            auto aIndex = queue[queueHead];
+            for (auto edge = aOffsets[aIndex]; edge < aOffsets[aIndex + 1];
+                 edge++)
+            {
+                auto nIndex = aTargets[edge];
+                if (aLabels[nIndex].load(std::memory_order_relaxed) ==
+                    subsetId and aStamps[nIndex] != subsetId + 1)
+                {
+                    aStamps[nIndex] = subsetId + 1;
+                    queue.push_back(nIndex);
+                }
+            }
+        }
+        auto aPeripheral = queue.back();
+
+        /* Grow the left part from that node until it is big enough. If the
+         * search runs dry (the subgraph is disconnected), start again from
+         * the next node in the subset that has not been claimed. */
+        queue.clear();
+        auto unclaimed = aSubset.begin();
+        auto claim = [&](unsigned aIndex)
+        {
+            aLabels[aIndex].store(leftId, std::memory_order_relaxed);
+            aLeft.push_back(aIndex);
+            queue.push_back(aIndex);
+        };
+        claim(aPeripheral);
+        queueHead = 0;
+        while (aLeft.size() < aLeftSize)
+        {
+            if (queueHead == queue.size())
+            {
+                while (aLabels[*unclaimed].load(std::memory_order_relaxed) !=
+                       subsetId) unclaimed++;
+                claim(*unclaimed);
+                continue;
+            }
+
+            auto aIndex = queue[queueHead++];
+            for (auto edge = aOffsets[aIndex]; edge < aOffsets[aIndex + 1] and
+                     aLeft.size() < aLeftSize; edge++)
+            {
+                auto nIndex = aTargets[edge];
+                if (aLabels[nIndex].load(std::memory_order_relaxed) ==
+                    subsetId) claim(nIndex);
+            }
+        }
+    }
+
+    /* Everything left over goes right. */
+    for (const auto& aIndex : aSubset)
+    {
+        if (aLabels[aIndex].load(std::memory_order_relaxed) == subsetId)
+        {
+            aLabels[aIndex].store(rightId, std::memory_order_relaxed);
+            aRight.push_back(aIndex);
+        }
+    }
+
+    /* We're done with these - free them before recursing. */
+    std::vector<unsigned>().swap(queue);
+    std::vector<unsigned>().swap(aSubset);
+    std::vector<unsigned>().swap(hSubset);
+
+    /* Recurse, giving half of our threads to each side. */
+    if (numThreads > 1)
+    {
+        std::thread leftThread(
+            &Problem::partition_bisect, this, leftId, std::ref(aLeft),
+            std::ref(hLeft), std::cref(aOffsets), std::cref(aTargets),
+            std::ref(aLabels), std::ref(aStamps), numThreads / 2);
+        partition_bisect(rightId, aRight, hRight, aOffsets, aTargets,
+                         aLabels, aStamps, numThreads - numThreads / 2);
+        leftThread.join();
+    }
+    else
+    {
+        partition_bisect(leftId, aLeft, hLeft, aOffsets, aTargets,
+                         aLabels, aStamps, 1);
+        partition_bisect(rightId, aRight, hRight, aOffsets, aTargets,
+                         aLabels, aStamps, 1);
+    }
+}
@@ -46,13 +46,26 @@ unsigned Problem::select_serial(decltype(nodeAs)::iterator& selA,
     return 0;
 }
 
+/* Rolls the index of an application node at random, respecting any
+ * restriction on selection (see restrict_selection). */
+decltype(Problem::nodeAs)::size_type Problem::roll_sela()
+{
+    if (selectableAs.empty())
+    {
+        std::uniform_int_distribution<decltype(nodeAs)::size_type>
+            distributionSelA(0, nodeAs.size() - 1);
+        return distributionSelA(rng);
+    }
+    std::uniform_int_distribution<decltype(selectableAs)::size_type>
+        distributionSelA(0, selectableAs.size() - 1);
+    return selectableAs[distributionSelA(rng)];
+}
+
 /* Serial selection of an application node at random. */
 void Problem::select_serial_sela(decltype(nodeAs)::iterator& selA)
 {
     selA = nodeAs.begin();
-    std::uniform_int_distribution<decltype(nodeAs)::size_type>
-        distributionSelA(0, nodeAs.size() - 1);
-    std::advance(selA, distributionSelA(rng));
+    std::advance(selA, roll_sela());
 }
 
 /* Retrieval of old hardware node given the application node. */
@@ -67,8 +80,8 @@ void Problem::select_serial_oldh(decltype(nodeAs)::iterator& selA,
 void Problem::select_serial_selh(decltype(nodeHs)::iterator& selH,
                                  decltype(nodeHs)::iterator& avoid)
 {
-    /* Reselect if the hardware node selected is full, or if it already
-     * contains the application node. This extra functionality becomes
+    /* Reselect if the hardware node selected is full or unavailable, or if it
+     * already contains the application node. This extra functionality becomes
      * inefficient as application graph "just fits" in the hardware graph. If
      * this is the case, consider increasing pMax instead. */
     auto attempt = Problem::selectionPatience;
@@ -84,7 +97,8 @@ void Problem::select_serial_selh(decltype(nodeHs)::iterator& selH,
         std::uniform_int_distribution<decltype(nodeHs)::size_type>
             distributionSelH(0, nodeHs.size() - 1);
         std::advance(selH, distributionSelH(rng));
-    } while ((*selH)->contents.size() >= pMax or selH == avoid);
+    } while ((*selH)->contents.size() >= pMax or !(*selH)->available or
+             selH == avoid);
 }
 
 /* Parallel semi-asynchronous selection. Selects:
@@ -123,8 +137,6 @@ unsigned Problem::select_parallel_sasynchronous_sela(
 {
     /* Select index for the application node, until we hit one that's not been
      * claimed already. */
-    std::uniform_int_distribution<decltype(nodeAs)::size_type>
-        distributionSelA(0, nodeAs.size() - 1);
     decltype(nodeAs)::size_type roll;
     auto attempt = Problem::selectionPatience;
     do
@@ -135,7 +147,7 @@ unsigned Problem::select_parallel_sasynchronous_sela(
             log("WARNING: Atomic application node selection is taking a "
                 "while. Try spawning fewer threads.");
         }
-        roll = distributionSelA(rng);
+        roll = roll_sela();
     }
     while (!nodeAs.at(roll)->lock.try_lock());
 
@@ -175,8 +187,6 @@ unsigned Problem::select_parallel_synchronous(decltype(nodeAs)::iterator& selA,
      * nodes at the same time in order to avoid races. */
 
     /* Roll the dice to select an application node. */
-    std::uniform_int_distribution<decltype(nodeAs)::size_type>
-        distributionSelA(0, nodeAs.size() - 1);
     decltype(nodeAs)::size_type roll;
     auto appAttempt = Problem::selectionPatience;
 
@@ -188,7 +198,7 @@ unsigned Problem::select_parallel_synchronous(decltype(nodeAs)::iterator& selA,
             log("WARNING: Synchronous application node selection is taking a "
                 "while. Try spawning fewer threads.");
         }
-        roll = distributionSelA(rng);
+        roll = roll_sela();
         selA = nodeAs.begin();
         std::advance(selA, roll);
 
@@ -286,7 +296,8 @@ unsigned Problem::select_parallel_synchronous(decltype(nodeAs)::iterator& selA,
         hwLockTotalAttempts += Problem::selectionPatience - hwLockAttempt;
 
         /* Try again if the node is invalid for another reason. */
-        if ((*selH)->contents.size() >= pMax or selH == oldH)
+        if ((*selH)->contents.size() >= pMax or !(*selH)->available or
+            selH == oldH)
             (*selH)->lock.unlock();
         else break;
     }
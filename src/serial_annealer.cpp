@@ -18,6 +18,48 @@ SerialAnnealer<DisorderT>::SerialAnnealer(
 template<class DisorderT>
 void SerialAnnealer<DisorderT>::anneal(Problem& problem)
 {
+    if (this->log)
+    {
+        anneal_with<LogToCsv, CheckConvergence, AnyDegree>(problem);
+        return;
+    }
+
+    if (this->checks_convergence())
+        anneal_with_degree<CheckConvergence>(problem);
+    else anneal_with_degree<NoConvergence>(problem);
+}
+
+/* Anneals without logging, with the degree policy that fits the problem's
+ * fixed-degree view (building it, and clearing it after). */
+template<class DisorderT>
+template<class ConvergenceT>
+void SerialAnnealer<DisorderT>::anneal_with_degree(Problem& problem)
+{
+    switch (this->begin_fixed_degree(problem))
+    {
+    case 2:
+        anneal_with<NoLogging, ConvergenceT, FixedDegree<2>>(problem);
+        break;
+    case 4:
+        anneal_with<NoLogging, ConvergenceT, FixedDegree<4>>(problem);
+        break;
+    default:
+        anneal_with<NoLogging, ConvergenceT, AnyDegree>(problem);
+    }
+    problem.clear_fixed_degree_view();
+}
+
+/* The anneal itself, for given logging, convergence and degree policies (see
+ * annealer_policies.hpp). */
+template<class DisorderT>
+template<class LogT, class ConvergenceT, class DegreeT>
+void SerialAnnealer<DisorderT>::anneal_with(Problem& problem)
+{
+    /* Scale disorder to the problem, if we've been asked to (unless
+     * resuming, in which case the schedule is restored instead). */
+    if (this->calibrationSamples > 0 and !this->resuming())
+        this->calibrate_disorder(problem);
+
     /* Set up logging.
      *
      * If no output directory has been defined, then we run without
@@ -32,7 +74,7 @@ void SerialAnnealer<DisorderT>::anneal(Problem& problem)
      * - A text file to which the wallclock runtime in seconds is dumped. */
     std::ofstream csvOut;
     std::ofstream clockOut;
-    if (this->log)
+    if constexpr (LogT::enabled)
     {
         csvOut.open(this->outDir / csvPath, std::ofstream::trunc);
         csvOut << "Selected application node index,"
@@ -46,88 +88,202 @@ void SerialAnnealer<DisorderT>::anneal(Problem& problem)
         this->write_metadata();
     }
 
+    /* Begin where we're told to. */
+    iteration = this->firstIteration;
+
     auto selA = problem.nodeAs.begin();
     auto selH = problem.nodeHs.begin();
     auto oldH = problem.nodeHs.begin();
 
-    /* Base fitness "used" from the start of each iteration. */
-    auto oldClusteringFitness = problem.compute_total_clustering_fitness();
-    auto oldLocalityFitness = problem.compute_total_locality_fitness();
+    /* Base fitness "used" from the start of each iteration, in exact units
+     * so that it doesn't drift from the true fitness as it is updated. */
+    auto oldClusteringFitness =
+        problem.compute_total_clustering_fitness_exact();
+    auto oldLocalityFitness = problem.compute_total_locality_fitness_exact();
     auto oldFitness = oldLocalityFitness + oldClusteringFitness;
 
     /* Write data for iteration zero to deploy initial fitness. */
-    if (this->log) csvOut << "-1,-1,"
-                          << oldFitness << ","
-                          << oldClusteringFitness << ","
-                          << oldLocalityFitness << ",1\n";
+    if constexpr (LogT::enabled)
+        csvOut << "-1,-1,"
+               << Problem::to_fitness(oldFitness) << ","
+               << Problem::to_fitness(oldClusteringFitness) << ","
+               << Problem::to_fitness(oldLocalityFitness) << ",1\n";
+
+    /* Convergence tracking, for stopping early. */
+    typedef typename Annealer<DisorderT>::StopReason StopReason;
+    typename Annealer<DisorderT>::Convergence convergence;
+    auto stopReason = StopReason::none;
+
+    /* Position in the disorder schedule. It is the iteration, unless we're
+     * running on a time budget, in which case it is held for each chunk
+     * (scheduleStride is zero). */
+    auto endIteration = this->end_iteration();
+    Iteration scheduleIteration = 0;
+    Iteration scheduleStride = this->timeBudget > 0 ? 0 : 1;
+    Iteration clockCountdown = 0;
+
+    /* Best-state retention, checkpointing every so often. */
+    this->begin_retention(problem, iteration);
+
+    /* Resume from a saved state, if we've been asked to. Countdowns carry on
+     * as if we'd never stopped. */
+    if (this->load_resume(problem, iteration, oldClusteringFitness,
+                          oldLocalityFitness, {&convergence, 1}))
+        oldFitness = oldLocalityFitness + oldClusteringFitness;
+    if (this->timeBudget > 0) scheduleIteration = iteration;
+    Iteration checkpointCountdown = this->countdown_after(
+        this->checkpointEvery, iteration - this->firstIteration);
+    Iteration resumeCountdown = this->countdown_after(
+        this->resumeEvery, iteration - this->firstIteration);
+
+    /* Background snapshots of the placement. */
+    progress = iteration;
+    this->begin_snapshots(problem, progress);
 
     /* Start the timer. */
     auto timeAtStart = std::chrono::steady_clock::now();
+    this->budgetStart = timeAtStart;
     do
     {
-        iteration++;
+        /* Run a chunk, up to the next thing that needs doing between
+         * iterations. */
+        auto chunk = std::min(this->chunkLength, endIteration - iteration);
+        if (checkpointCountdown > 0)
+            chunk = std::min(chunk, checkpointCountdown);
+        if (resumeCountdown > 0) chunk = std::min(chunk, resumeCountdown);
+        auto chunkStart = iteration;
+        auto chunkEnd = iteration + chunk;
+        while (iteration < chunkEnd)
+        {
+            iteration++;
+
+            /* Selection */
+            problem.select_serial(selA, selH, oldH);
+            if constexpr (LogT::enabled)
+                csvOut << selA - problem.nodeAs.begin() << ","
+                       << selH - problem.nodeHs.begin() << ",";
 
-        /* Selection */
-        problem.select_serial(selA, selH, oldH);
-        if (this->log) csvOut << selA - problem.nodeAs.begin() << ","
-                              << selH - problem.nodeHs.begin() << ",";
+            /* Fitness of components before transformation. */
+            auto oldClusteringFitnessComponents =
+                problem.compute_hw_node_clustering_fitness_exact(**selH) +
+                problem.compute_hw_node_clustering_fitness_exact(**oldH);
 
-        /* Fitness of components before transformation. */
-        auto oldClusteringFitnessComponents =
-            problem.compute_hw_node_clustering_fitness(**selH) +
-            problem.compute_hw_node_clustering_fitness(**oldH);
+            auto oldLocalityFitnessComponents =
+                problem.compute_app_node_locality_fitness_exact<
+                    DegreeT::maxDegree>(selA) * 2;
 
-        auto oldLocalityFitnessComponents =
-            problem.compute_app_node_locality_fitness(**selA) * 2;
+            /* Transformation */
+            problem.transform_with<DegreeT::maxDegree != 0, LogT::enabled>(
+                selA, selH, oldH);
 
-        /* Transformation */
-        problem.transform(selA, selH, oldH);
+            /* Fitness of components after transformation. */
+            auto newClusteringFitnessComponents =
+                problem.compute_hw_node_clustering_fitness_exact(**selH) +
+                problem.compute_hw_node_clustering_fitness_exact(**oldH);
 
-        /* Fitness of components after transformation. */
-        auto newClusteringFitnessComponents =
-            problem.compute_hw_node_clustering_fitness(**selH) +
-            problem.compute_hw_node_clustering_fitness(**oldH);
+            auto newLocalityFitnessComponents =
+                problem.compute_app_node_locality_fitness_exact<
+                    DegreeT::maxDegree>(selA) * 2;
 
-        auto newLocalityFitnessComponents =
-            problem.compute_app_node_locality_fitness(**selA) * 2;
+            /* New fitness computation, and writing to CSV. */
+            auto newClusteringFitness = oldClusteringFitness -
+                oldClusteringFitnessComponents +
+                newClusteringFitnessComponents;
 
-        /* New fitness computation, and writing to CSV. */
-        auto newClusteringFitness = oldClusteringFitness -
-            oldClusteringFitnessComponents + newClusteringFitnessComponents;
+            auto newLocalityFitness = oldLocalityFitness -
+                oldLocalityFitnessComponents + newLocalityFitnessComponents;
 
-        auto newLocalityFitness = oldLocalityFitness -
-            oldLocalityFitnessComponents + newLocalityFitnessComponents;
+            auto newFitness = newLocalityFitness + newClusteringFitness;
 
-        auto newFitness = newLocalityFitness + newClusteringFitness;
+            if constexpr (LogT::enabled)
+                csvOut << Problem::to_fitness(newFitness) << ","
+                       << Problem::to_fitness(newClusteringFitness) << ","
+                       << Problem::to_fitness(newLocalityFitness) << ",";
 
-        if (this->log) csvOut << newFitness << ","
-                              << newClusteringFitness << ","
-                              << newLocalityFitness << ",";
+            /* Determination. This only depends on the difference in fitness,
+             * which is passed exactly (relative to zero), rather than as two
+             * large and nearly-equal floats. */
+            auto fitnessDifference = static_cast<float>(
+                Problem::to_fitness(newFitness - oldFitness));
+            bool sufficientlyDetermined = this->disorder.determine(
+                0, fitnessDifference, this->reheated(
+                    scheduleIteration + iteration * scheduleStride));
 
-        /* Determination */
-        bool sufficientlyDetermined =
-            this->disorder.determine(oldFitness, newFitness, iteration);
+            /* If the solution was sufficiently determined to be chosen,
+             * update the base fitness to support computation for the next
+             * iteration. Otherwise, revert the solution. */
+            if (sufficientlyDetermined)
+            {
+                if constexpr (LogT::enabled) csvOut << 1 << '\n';
+                oldFitness = newFitness;
+                oldClusteringFitness = newClusteringFitness;
+                oldLocalityFitness = newLocalityFitness;
+            }
 
-        /* If the solution was sufficiently determined to be chosen, update the
-         * base fitness to support computation for the next
-         * iteration. Otherwise, revert the solution. */
-        if (sufficientlyDetermined)
+            else
+            {
+                if constexpr (LogT::enabled) csvOut << 0 << '\n';
+                problem.transform_with<DegreeT::maxDegree != 0,
+                                       LogT::enabled>(selA, oldH, selH);
+            }
+
+            if constexpr (ConvergenceT::enabled)
+            {
+                stopReason = this->check_convergence(
+                    convergence, Problem::to_fitness(oldFitness),
+                    sufficientlyDetermined);
+                if (stopReason != StopReason::none) break;
+            }
+        }
+        progress.store(iteration, std::memory_order_relaxed);
+
+        /* Retention. If we've restarted from the best state, our fitness is
+         * out of date. */
+        auto ran = iteration - chunkStart;
+        if (checkpointCountdown > 0 and (checkpointCountdown -= ran) == 0)
         {
-            if (this->log) csvOut << 1 << '\n';
-            oldFitness = newFitness;
-            oldClusteringFitness = newClusteringFitness;
-            oldLocalityFitness = newLocalityFitness;
+            checkpointCountdown = this->checkpointEvery;
+            if (this->checkpoint(
+                    problem, Problem::to_fitness(oldFitness), iteration,
+                    scheduleIteration + iteration * scheduleStride))
+            {
+                oldClusteringFitness =
+                    problem.compute_total_clustering_fitness_exact();
+                oldLocalityFitness =
+                    problem.compute_total_locality_fitness_exact();
+                oldFitness = oldLocalityFitness + oldClusteringFitness;
+            }
         }
 
-        else
+        if (this->timeBudget > 0 and
+            !this->advance_schedule(clockCountdown, scheduleIteration, ran))
+            stopReason = StopReason::budgetSpent;
+
+        /* Saving, for resuming later (unless there is nothing left to
+         * resume). */
+        if (resumeCountdown > 0 and (resumeCountdown -= ran) == 0)
         {
-            if (this->log) csvOut << 0 << '\n';
-            problem.transform(selA, oldH, selH);
+            resumeCountdown = this->resumeEvery;
+            if (stopReason == StopReason::none and iteration < endIteration)
+                this->save_resume(problem, iteration, oldClusteringFitness,
+                                  oldLocalityFitness, {&convergence, 1});
         }
     }
-    while (iteration != this->maxIteration);  /* Termination */
+    while (iteration < endIteration and
+           stopReason == StopReason::none);  /* Termination */
 
-    if (this->log)
+    this->iterationsRun = iteration - this->firstIteration;
+    if (stopReason != StopReason::none)
+    {
+        std::stringstream message;
+        message << "Stopped at iteration " << iteration << " ("
+                << this->describe(stopReason) << ").";
+        problem.log(message.str());
+    }
+    this->end_retention(problem);
+    this->end_snapshots();
+
+    if constexpr (LogT::enabled)
     {
         /* Write the elapsed time to the wallclock log file. */
         clockOut << std::chrono::duration_cast<std::chrono::seconds>(
@@ -0,0 +1,104 @@
+#include "snapshotter.hpp"
+
+#include "binary_io.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+/* Publishes the placement of the problem, and starts snapshotting it every
+ * `periodSeconds` seconds into `dir` (which is created if need be). */
+Snapshotter::Snapshotter(Problem& problemArg,
+                         const std::filesystem::path& dirArg,
+                         double periodSeconds,
+                         const std::atomic<Iteration>& progressArg):
+    problem(problemArg),
+    dir(dirArg),
+    period(std::max(periodSeconds, 0.0)),
+    progress(progressArg)
+{
+    std::filesystem::create_directories(dir);
+    problem.publish_locations();
+    thread = std::thread(&Snapshotter::run, this);
+}
+
+/* Stops the background thread, takes a final snapshot (so that the last
+ * snapshot is of the placement the anneal ended on), and withdraws the
+ * placement. */
+Snapshotter::~Snapshotter()
+{
+    {
+        std::lock_guard<std::mutex> guard(stopLock);
+        stopping = true;
+    }
+    stopSignal.notify_one();
+    thread.join();
+    take();
+    problem.withdraw_locations();
+
+    std::stringstream message;
+    message << "Wrote " << epoch << " placement snapshot(s) to "
+            << dir.string() << ".";
+    problem.log(message.str());
+}
+
+/* Snapshots every period, until stopped. */
+void Snapshotter::run()
+{
+    std::unique_lock<std::mutex> guard(stopLock);
+    while (!stopSignal.wait_for(guard, period, [this]{return stopping;}))
+    {
+        guard.unlock();
+        take();
+        guard.lock();
+    }
+}
+
+/* Copies the published placement and writes it out. */
+void Snapshotter::take()
+{
+    Iteration iteration = progress.load(std::memory_order_relaxed);
+    problem.read_published_locations(aToH);
+
+    std::stringstream name;
+    name << "snapshot-" << epoch << ".bin";
+    auto path = dir / name.str();
+    bool written = write_atomically(path, [&](std::ostream& out)
+    {
+        out.write(magic, sizeof(magic));
+        write_binary(out, version);
+        write_binary(out, std::uint32_t(0));  /* Reserved */
+        write_binary(out, epoch);
+        write_binary(out, std::uint64_t(iteration));
+        write_binary(out, aToH);
+    });
+
+    if (!written)
+    {
+        problem.log("Failed to write placement snapshot " + path.string() +
+                    ".");
+        return;
+    }
+    epoch++;
+}
+
+/* Reads the snapshot at `path` into `aToH`, `epoch` and `iteration`. */
+bool Snapshotter::read(const std::filesystem::path& path,
+                       std::vector<unsigned>& aToH, std::uint64_t& epoch,
+                       Iteration& iteration)
+{
+    std::ifstream in(path, std::ifstream::binary);
+    char fileMagic[sizeof(magic)];
+    std::uint32_t fileVersion;
+    std::uint32_t reserved;
+    std::uint64_t fileIteration;
+    in.read(fileMagic, sizeof(fileMagic));
+    if (!read_binary(in, fileVersion) or !read_binary(in, reserved) or
+        !std::equal(magic, magic + sizeof(magic), fileMagic) or
+        fileVersion != version) return false;
+
+    if (!read_binary(in, epoch) or !read_binary(in, fileIteration) or
+        !read_binary(in, aToH)) return false;
+    iteration = fileIteration;
+    return true;
+}
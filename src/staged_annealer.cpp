@@ -0,0 +1,276 @@
+#include "staged_annealer.hpp"
+#include "serial_annealer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <thread>
+
+template<class DisorderT>
+StagedAnnealer<DisorderT>::StagedAnnealer(
+    unsigned numThreadsArg,
+    Iteration maxIterationArg,
+    const std::filesystem::path& outDirArg,
+    Seed disorderSeedArg):
+    Annealer<DisorderT>(maxIterationArg, outDirArg, "StagedAnnealer",
+                        disorderSeedArg),
+    numThreads(numThreadsArg),
+    disorderSeed(disorderSeedArg){}
+
+/* Hits the solution with a sledgehammer, then with smaller and smaller
+ * hammers on each piece that breaks off.
+ *
+ * Each level of the hardware hierarchy is a stage. At each stage, every
+ * subproblem (application nodes, and the hardware nodes they are confined to)
+ * has its hardware nodes grouped by their address at that level. The
+ * application nodes are annealed onto those groups, and each group becomes a
+ * subproblem at the next stage. If hardware nodes have no addresses, there is
+ * a single stage that anneals onto hardware nodes directly.
+ *
+ * Each stage gets an equal share of the iteration budget, which is divided
+ * between the subproblems of that stage in proportion to their number of
+ * application nodes. The placement in the problem is used to seed each
+ * stage, and is replaced by the result at the end. */
+template<class DisorderT>
+void StagedAnnealer<DisorderT>::anneal(Problem& problem)
+{
+    /* Set up logging.
+     *
+     * If no output directory has been defined, then we run without
+     * logging. Logging clobbers previous anneals. There are two output files
+     * created in this way:
+     *
+     * - A CSV file describing each subproblem that was annealed, where each
+     *   row corresponds to a subproblem.
+     *
+     * - A text file to which the wallclock runtime in seconds is dumped. */
+    std::ofstream csvOut;
+    std::ofstream clockOut;
+    if (this->log)
+    {
+        csvOut.open(this->outDir / csvPath, std::ofstream::trunc);
+        csvOut << "Level,"
+               << "Subproblem index,"
+               << "Application nodes,"
+               << "Hardware groups,"
+               << "Iterations,"
+               << "Initial Fitness,"
+               << "Final Fitness\n";
+
+        clockOut.open(this->outDir / clockPath, std::ofstream::trunc);
+        write_metadata();
+    }
+
+    /* Address of each hardware node. Fall back to the index if addresses are
+     * undefined, and append the index if addresses are not unique (so that
+     * the last stage always anneals onto individual hardware nodes). */
+    std::vector<std::vector<unsigned>> hAddresses(problem.nodeHs.size());
+    if (problem.compute_h_hierarchy_depth() == 0)
+    {
+        problem.log("Hardware nodes have no (consistent) addresses - staged "
+                    "annealing will use a single stage.");
+        for (const auto& nodeH : problem.nodeHs)
+            hAddresses[nodeH->index] = {nodeH->index};
+    }
+    else
+    {
+        std::set<std::vector<unsigned>> unique;
+        for (const auto& nodeH : problem.nodeHs)
+        {
+            hAddresses[nodeH->index] = nodeH->address;
+            unique.insert(nodeH->address);
+        }
+        if (unique.size() != problem.nodeHs.size())
+            for (const auto& nodeH : problem.nodeHs)
+                hAddresses[nodeH->index].push_back(nodeH->index);
+    }
+    auto depth = hAddresses.empty() ? 0 : hAddresses.front().size();
+
+    /* Seed generator for subproblems, so that a seeded anneal is
+     * reproducible regardless of which thread picks up which subproblem. */
+    Prng seeder(determine_seed(disorderSeed));
+
+    /* Everything starts in one subproblem (on the hardware nodes that are in
+     * service). */
+    std::vector<Subproblem> subproblems(1);
+    subproblems.front().aIndices.resize(problem.nodeAs.size());
+    std::iota(subproblems.front().aIndices.begin(),
+              subproblems.front().aIndices.end(), 0);
+    for (const auto& nodeH : problem.nodeHs)
+        if (nodeH->available)
+            subproblems.front().hIndices.push_back(nodeH->index);
+
+    auto timeAtStart = std::chrono::steady_clock::now();
+    std::atomic<Iteration> iterationsRun = 0;
+    for (decltype(depth) level = 0; level < depth; level++)
+    {
+        {
+            std::stringstream message;
+            message << "Annealing stage " << level + 1 << " of " << depth
+                    << " (" << subproblems.size() << " subproblem(s)).";
+            problem.log(message.str());
+        }
+
+        std::vector<Seed> seeds(subproblems.size());
+        for (auto& seed : seeds) seed = seeder();
+
+        /* The next stage's subproblems, and output, from each subproblem. */
+        std::vector<std::vector<Subproblem>> children(subproblems.size());
+        std::vector<std::string> csvRows(subproblems.size());
+
+        /* Each worker takes the next subproblem that nobody is working on,
+         * until there are none left. */
+        std::atomic<std::size_t> next = 0;
+        auto work = [&]()
+        {
+            std::size_t index;
+            while ((index = next++) < subproblems.size())
+            {
+                const auto& subproblem = subproblems[index];
+
+                /* Group hardware nodes by their address at this level. */
+                std::map<unsigned, std::vector<unsigned>> hGroupGivenAddress;
+                for (const auto& hIndex : subproblem.hIndices)
+                    hGroupGivenAddress[hAddresses[hIndex][level]]
+                        .push_back(hIndex);
+                std::vector<std::vector<unsigned>> hGroups;
+                for (auto& [address, hGroup] : hGroupGivenAddress)
+                    hGroups.push_back(std::move(hGroup));
+
+                /* Nothing to decide - pass it through to the next stage. */
+                if (hGroups.size() == 1 or subproblem.aIndices.empty())
+                {
+                    children[index].push_back(subproblem);
+                    continue;
+                }
+
+                /* Define and anneal the coarse problem, unless it is so full
+                 * that selection could run out of moves. There are always
+                 * two groups under the coarse pMax (so that every
+                 * application node has somewhere to go) while the groups
+                 * could take another pMax application nodes between them,
+                 * counting groups that start over the coarse pMax (see
+                 * define_coarse_problem) as full. */
+                Problem coarse;
+                coarse.set_seed(seeds[index]);
+                problem.define_coarse_problem(coarse, subproblem.aIndices,
+                                              hGroups);
+
+                Iteration iterations = std::max<Iteration>(
+                    1, this->maxIteration / depth *
+                    subproblem.aIndices.size() / problem.nodeAs.size());
+                auto initialFitness = coarse.compute_total_fitness();
+                if (subproblem.aIndices.size() + coarse.pMax >=
+                    static_cast<unsigned long long>(coarse.pMax) *
+                    hGroups.size()) iterations = 0;
+                else
+                {
+                    SerialAnnealer<DisorderT> annealer(iterations, "",
+                                                       seeds[index]);
+                    annealer.warm_start(this->warmStartFraction);
+
+                    /* Stopping criteria, calibration, and retention carry
+                     * over, except the target, because coarse fitness is
+                     * not comparable. */
+                    annealer.stop_on_stagnation(this->stagnationWindow);
+                    annealer.stop_on_low_acceptance(
+                        this->acceptanceThreshold, this->acceptanceWindow);
+                    if (this->calibrationSamples > 0)
+                        annealer.calibrate(this->startAcceptance,
+                                           this->endAcceptance,
+                                           this->calibrationSamples);
+                    annealer.retain_best(this->checkpointEvery);
+                    annealer.reheat_on_stagnation(this->reheatWindow,
+                                                  this->reheatFraction,
+                                                  this->restartFromBest);
+                    annealer(coarse);
+                    iterationsRun += annealer.iterationsRun;
+                }
+
+                std::stringstream csvRow;
+                csvRow << level << "," << index << ","
+                       << subproblem.aIndices.size() << ","
+                       << hGroups.size() << ","
+                       << iterations << ","
+                       << initialFitness << ","
+                       << coarse.compute_total_fitness() << "\n";
+                csvRows[index] = csvRow.str();
+
+                /* Each group becomes a subproblem. */
+                children[index].resize(hGroups.size());
+                for (decltype(hGroups)::size_type group = 0;
+                     group < hGroups.size(); group++)
+                    children[index][group].hIndices = std::move(
+                        hGroups[group]);
+                for (std::size_t coarseIndex = 0;
+                     coarseIndex < coarse.nodeAs.size(); coarseIndex++)
+                {
+                    auto group = coarse.nodeAs[coarseIndex]->location.lock()
+                        ->index;
+                    children[index][group].aIndices.push_back(
+                        subproblem.aIndices[coarseIndex]);
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned threadId = 0; threadId < numThreads; threadId++)
+            threads.emplace_back(work);
+        for (auto& thread : threads) thread.join();
+
+        /* Write output and move on to the next stage. */
+        if (this->log) for (const auto& csvRow : csvRows) csvOut << csvRow;
+        subproblems.clear();
+        for (auto& someChildren : children)
+            for (auto& child : someChildren)
+                subproblems.push_back(std::move(child));
+    }
+
+    this->iterationsRun = iterationsRun;
+
+    /* Every subproblem now holds a single hardware node - apply the
+     * result. */
+    for (const auto& nodeH : problem.nodeHs) nodeH->contents.clear();
+    for (const auto& subproblem : subproblems)
+    {
+        const auto& nodeH = problem.nodeHs[subproblem.hIndices.front()];
+        for (const auto& aIndex : subproblem.aIndices)
+        {
+            problem.nodeAs[aIndex]->location = std::weak_ptr(nodeH);
+            nodeH->contents.insert(problem.nodeAs[aIndex].get());
+        }
+    }
+
+    if (this->log)
+    {
+        /* Write the elapsed time to the wallclock log file. */
+        clockOut << std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now() - timeAtStart).count()
+                 << std::endl;
+
+        /* Close log files */
+        csvOut.close();
+        clockOut.close();
+    }
+}
+
+/* Uses the annealer to write metadata, then appends the number of threads to
+ * the file. */
+template<class DisorderT>
+void StagedAnnealer<DisorderT>::write_metadata()
+{
+    Annealer<DisorderT>::write_metadata();
+    if (this->log)
+    {
+        std::ofstream metadata;
+        metadata.open(this->outDir / this->metadataName, std::ofstream::app);
+        metadata << "threadCount = " << numThreads << std::endl;
+        metadata.close();
+    }
+}
+
+#include "staged_annealer-impl.hpp"
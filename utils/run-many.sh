@@ -1,16 +1,14 @@
 #!/bin/bash
 
-# This script runs a series of placement jobs. It, along with
-# main_config_template.hpp, need to be deployed to the root directory of the
-# repository. This script must also be called from that directory (I'm too lazy
-# to write the chdir logic).
+# This script runs a series of placement jobs. It needs to be called from the
+# root directory of the repository (I'm too lazy to write the chdir logic).
+# The annealer is built once, and each job configures it on the command line
+# (see ./psap-run --help).
 #
 # Read and understand before running.
 set -e
 set -x
 
-TEMPLATE_SOURCE="main_config_template.hpp"
-TEMPLATE_TARGET="include/main_config.hpp"
 ITERATIONS=5e9
 
 # Mouse mode disables all logging and intermediate fitness computation, and
@@ -35,6 +33,54 @@ else
     SYNC_TEXT="sync"
 fi
 
+# Where non-mouse runs write their output.
+OUTPUT_ROOT="/mnt/external/mlv"
+
+# Run every job in one process instead (see sweepSpec in main_config.hpp),
+# which prepares the problem only once, and writes one row of results per job
+# to sweep.csv (or to stdout in mouse mode).
+IN_PROCESS=0
+
+# Build
+scons -j 4
+
+# Options common to every job.
+COMMON_ARGS=(--iterations "${ITERATIONS}" "--${SYNC_TEXT}")
+if [ ${MOUSE_MODE} -eq 1 ]; then
+    COMMON_ARGS+=(--mouse)
+fi
+if [ ${USE_SEED} -eq 1 ]; then
+    COMMON_ARGS+=(--seed "${SEED}")
+fi
+
+if [ ${IN_PROCESS} -eq 1 ]; then
+    MODES=""
+    WORKERS=""
+    for THREAD_COUNT in $THREAD_COUNTS; do
+        if [ ${THREAD_COUNT} -eq 0 ]; then
+            MODES="serial"
+        else
+            WORKERS="${WORKERS:+${WORKERS},}${THREAD_COUNT}"
+        fi
+    done
+
+    # Leave workers out (and parallel jobs with them) if there are none.
+    if [ -n "${WORKERS}" ]; then
+        MODES="${MODES:+${MODES},}parallel"
+        SWEEP="modes=${MODES} workers=${WORKERS} repeats=${REPEAT_COUNTS}"
+    else
+        SWEEP="modes=${MODES} repeats=${REPEAT_COUNTS}"
+    fi
+    if [ ${MOUSE_MODE} -eq 1 ]; then
+        MOUSE_FILE="mouse_out_${ITERATIONS}_${SYNC_TEXT}_sweep.txt"
+        ./psap-run "${COMMON_ARGS[@]}" --sweep "${SWEEP}" > "${MOUSE_FILE}"
+    else
+        ./psap-run "${COMMON_ARGS[@]}" --sweep "${SWEEP}" --out "${OUTPUT_ROOT}"
+        mv --verbose "${OUTPUT_ROOT}/poets_box_2d_grid" "${OUTPUT_ROOT}/poets_box_2d_grid_sweep_$(date --iso-8601=second)_$(git rev-parse HEAD)"
+    fi
+    exit
+fi
+
 # Gogogo
 for REPEAT in $(seq 1 ${REPEAT_COUNTS}); do
 
@@ -47,49 +93,22 @@ for REPEAT in $(seq 1 ${REPEAT_COUNTS}); do
     # parallel placement job for different numbers of compute workers.
     for THREAD_COUNT in $THREAD_COUNTS; do
 
-	    # Deploy template, and provision.
-	    cp "${TEMPLATE_SOURCE}" "${TEMPLATE_TARGET}"
-	    sed -i "s|{{ITERATIONS}}|$ITERATIONS|" "${TEMPLATE_TARGET}"
-
-	    if [ ${MOUSE_MODE} -eq 1 ]; then
-            sed -i "s|{{MOUSE_MODE}}|true|" "${TEMPLATE_TARGET}"
-	    else
-            sed -i "s|{{MOUSE_MODE}}|false|" "${TEMPLATE_TARGET}"
-	    fi
-
-	    if [ ${FULLY_SYNCHRONOUS} -eq 1 ]; then
-            sed -i "s|{{FULLY_SYNCHRONOUS}}|true|" "${TEMPLATE_TARGET}"
-	    else
-            sed -i "s|{{FULLY_SYNCHRONOUS}}|false|" "${TEMPLATE_TARGET}"
-	    fi
-
 	    if [ ${THREAD_COUNT} -eq 0 ]; then
-            sed -i "s|{{SERIAL_MODE}}|true|" "${TEMPLATE_TARGET}"
-            sed -i "s|{{NUM_THREADS}}|1|" "${TEMPLATE_TARGET}"
+            JOB_ARGS=(--mode serial --workers 1)
 	    else
-            sed -i "s|{{SERIAL_MODE}}|false|" "${TEMPLATE_TARGET}"
-            sed -i "s|{{NUM_THREADS}}|$THREAD_COUNT|" "${TEMPLATE_TARGET}"
+            JOB_ARGS=(--mode parallel --workers "${THREAD_COUNT}")
 	    fi
 
-        if [ ${USE_SEED} -eq 0 ]; then
-            sed -i "s|{{USE_SEED}}|false|" "${TEMPLATE_TARGET}"
-        else
-            sed -i "s|{{USE_SEED}}|true|" "${TEMPLATE_TARGET}"
-        fi
-        sed -i "s|{{SEED}}|$SEED|" "${TEMPLATE_TARGET}"
-
-	    # Build
-	    scons -j 4
-
 	    # Run
 	    if [ ${MOUSE_MODE} -eq 1 ]; then
             # Pushing output to file.
             printf "${THREAD_COUNT}," >> ${MOUSE_FILE}
-            ./psap-run >> ${MOUSE_FILE}
+            ./psap-run "${COMMON_ARGS[@]}" "${JOB_ARGS[@]}" >> ${MOUSE_FILE}
 	    else
-            # Log angrily, moving results afterwards.
-            ./psap-run
-            mv --verbose output/poets_box_2d_grid "/mnt/external/mlv/poets_box_2d_grid_${THREAD_COUNT}_$(date --iso-8601=second)_$(git rev-parse HEAD)"
+            # Log angrily, then rename the results (which are written to a
+            # directory named after the problem).
+            ./psap-run "${COMMON_ARGS[@]}" "${JOB_ARGS[@]}" --out "${OUTPUT_ROOT}"
+            mv --verbose "${OUTPUT_ROOT}/poets_box_2d_grid" "${OUTPUT_ROOT}/poets_box_2d_grid_${THREAD_COUNT}_$(date --iso-8601=second)_$(git rev-parse HEAD)"
 	    fi
     done
 done